@@ -0,0 +1,100 @@
+#include "Analysis.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+unsigned long long splitmix(unsigned long long z) {
+    z += 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// uniform number from (0, 1] depending only on the seed, the sample and the variation, so results do not
+// depend on the number of threads; every sample gets its own state, so no two of them share numbers
+double uniform(unsigned long long seed, long sample, int k) {
+    unsigned long long state = splitmix(seed ^ splitmix((unsigned long long) sample));
+    return ((splitmix(state + 0x9E3779B97F4A7C15ull * (unsigned long long) k) >> 11) + 1) * 0x1.0p-53;
+}
+
+void addReadings(vector<Statistics> &stats, const vector<double> &readings) {
+    if (stats.size() < readings.size()) stats.resize(readings.size());
+    for (int k(0); k < readings.size(); k++) stats[k].add(readings[k]);
+}
+
+} // namespace
+
+Analysis analyse(const Circuit &circuit, const vector<Variation> &variations, long samples, int noOfThreads,
+                 unsigned long long seed) {
+    for (const Variation &v: variations)
+        if (v.component < 0 || v.component >= circuit.noOfComponents())
+            throw out_of_range("Component out of boundaries");
+    const long chunk = 64;
+    atomic<long> next(0);
+    mutex merging;
+    Analysis result;
+    auto worker = [&]() {
+        Circuit cir = circuit;
+        Analysis local;
+        for (long first = next.fetch_add(chunk); first < samples; first = next.fetch_add(chunk)) {
+            for (long s = first; s < min(first + chunk, samples); s++) {
+                for (int k(0); k < variations.size(); k++) {
+                    const Variation &v = variations[k];
+                    double value = v.a;
+                    if (v.kind == Variation::Sweep && samples > 1) value += (v.b - v.a) * s / (samples - 1);
+                    else if (v.kind == Variation::Uniform) value += (v.b - v.a) * uniform(seed, s, 2 * k);
+                    else if (v.kind == Variation::Normal) // Box-Muller
+                        value += v.b * sqrt(-2 * log(uniform(seed, s, 2 * k))) * cos(2 * M_PI * uniform(seed, s, 2 * k + 1));
+                    cir.setComponentValue(v.component, value);
+                }
+                try {
+                    cir.solve();
+                    Readings r = cir.readings();
+                    addReadings(local.voltmeters, r.voltmeters);
+                    addReadings(local.ammeters, r.ammeters);
+                    addReadings(local.wattmeters, r.wattmeters);
+                } catch (exception &) {
+                    local.failed++;
+                }
+                local.samples++;
+            }
+        }
+        lock_guard<mutex> lock(merging);
+        result.samples += local.samples;
+        result.failed += local.failed;
+        vector<Statistics> *from[] = {&local.voltmeters, &local.ammeters, &local.wattmeters};
+        vector<Statistics> *to[] = {&result.voltmeters, &result.ammeters, &result.wattmeters};
+        for (int k(0); k < 3; k++) {
+            if (to[k]->size() < from[k]->size()) to[k]->resize(from[k]->size());
+            for (int l(0); l < from[k]->size(); l++) (*to[k])[l].merge((*from[k])[l]);
+        }
+    };
+    if (noOfThreads < 1) noOfThreads = (int) max(1u, thread::hardware_concurrency());
+    vector<thread> pool;
+    for (int t(1); t < noOfThreads; t++) pool.emplace_back(worker);
+    worker();
+    for (thread &t: pool) t.join();
+    return result;
+}
+
+void printAnalysis(const Analysis &a, ostream &out) {
+    out << "\nUzoraka: " << a.samples << " (neuspjelih: " << a.failed << ")\n";
+    auto print = [&out](const vector<Statistics> &stats, const string &title, const string &name,
+                        double scale, const string &unit) {
+        if (!stats.empty()) out << "\n" << title << ":\n";
+        for (int k(0); k < stats.size(); k++) {
+            const Statistics &s = stats[k];
+            out << name << "_" << k + 1 << " = " << fixed3(s.getMean() * scale) << unit
+                << " (σ = " << fixed3(s.getDeviation() * scale) << unit << ", min = " << fixed3(s.getMin() * scale)
+                << unit << ", max = " << fixed3(s.getMax() * scale) << unit << ")\n";
+        }
+    };
+    print(a.ammeters, "Ampermetri", "Ia", 1000, "mA");
+    print(a.wattmeters, "Vatmetri", "Pw", 1000, "mW");
+    print(a.voltmeters, "Voltmetri", "Uv", 1, "V");
+}
@@ -0,0 +1,57 @@
+#ifndef DCCALCULATOR_ANALYSIS_H
+#define DCCALCULATOR_ANALYSIS_H
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include "Circuit.h"
+
+struct Variation { // how analyse() varies one component of the circuit
+    enum Kind { Sweep, Uniform, Normal };
+    int component;
+    Kind kind;
+    double a, b; // from and to for Sweep and Uniform, mean and standard deviation for Normal
+};
+
+class Statistics { // mean, variance and range of one reading, updated sample by sample (Welford)
+    long count = 0;
+    double mean = 0, m2 = 0, lo = std::numeric_limits<double>::infinity(), hi = -std::numeric_limits<double>::infinity();
+public:
+    void add(double x) {
+        double delta = x - mean;
+        mean += delta / ++count;
+        m2 += delta * (x - mean);
+        lo = std::min(lo, x);
+        hi = std::max(hi, x);
+    }
+    void merge(const Statistics &s) {
+        if (s.count == 0) return;
+        long total = count + s.count;
+        double delta = s.mean - mean;
+        mean += delta * s.count / total;
+        m2 += s.m2 + delta * delta * count / total * s.count;
+        count = total;
+        lo = std::min(lo, s.lo);
+        hi = std::max(hi, s.hi);
+    }
+    long getCount() const { return count; }
+    double getMean() const { return mean; }
+    double getDeviation() const { return count > 1 ? std::sqrt(m2 / (count - 1)) : 0; }
+    double getMin() const { return lo; }
+    double getMax() const { return hi; }
+};
+
+struct Analysis {
+    std::vector<Statistics> voltmeters, ammeters, wattmeters;
+    long samples = 0, failed = 0;
+};
+
+// Solves the circuit for every sample of the varied component values, each thread on its own copy of the
+// circuit (so the factorization is redone in place), and keeps only the statistics of the meter readings.
+Analysis analyse(const Circuit &circuit, const std::vector<Variation> &variations, long samples, int noOfThreads = 0,
+                 unsigned long long seed = 1);
+void printAnalysis(const Analysis &a, std::ostream &out = std::cout);
+
+#endif //DCCALCULATOR_ANALYSIS_H
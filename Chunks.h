@@ -0,0 +1,46 @@
+#ifndef DCCALCULATOR_CHUNKS_H
+#define DCCALCULATOR_CHUNKS_H
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+const int maxForcedChunks = 256; // one thread each
+inline int forcedChunks = 0; // 0: chunks follow the size of the work and the number of cores
+
+// Splits all later work into exactly this many chunks (at most maxForcedChunks), so tests can run the
+// chunked paths on small inputs; 0 restores the default.
+inline void setNoOfChunks(int chunks) {
+    forcedChunks = std::clamp(chunks, 0, maxForcedChunks);
+}
+
+// Work of the given size split into one chunk per core, none of them smaller than minChunk, unless forced.
+inline int noOfChunks(size_t size, size_t minChunk) {
+    if (forcedChunks) return forcedChunks;
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    return (int) std::max<size_t>(1, std::min(cores, size / minChunk));
+}
+
+// Runs f(chunk) for every chunk on its own thread, the first one on the calling thread. Chunks write into
+// their own buffers, which are then joined in chunk order, so results do not depend on the number of chunks
+// or on timing; likewise the exception of the first failing chunk is the one rethrown.
+inline void forEachChunk(int noOfChunks, const std::function<void(int)> &f) {
+    std::vector<std::exception_ptr> errors(noOfChunks);
+    auto run = [&](int c) {
+        try {
+            f(c);
+        } catch (...) {
+            errors[c] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int c(1); c < noOfChunks; c++) pool.emplace_back(run, c);
+    run(0);
+    for (std::thread &t: pool) t.join();
+    for (const std::exception_ptr &error: errors)
+        if (error) std::rethrow_exception(error);
+}
+
+#endif //DCCALCULATOR_CHUNKS_H
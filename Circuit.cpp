@@ -0,0 +1,903 @@
+#include "Circuit.h"
+#include "Chunks.h"
+#include "DisjointSets.h"
+#include "MappedFile.h"
+#include "ResultWriter.h"
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+using Eigen::SparseMatrix;
+using Eigen::Triplet;
+using namespace std;
+
+string fixed3(double x) {
+    char s[32];
+    snprintf(s, sizeof(s), "%.3lf", x);
+    return s;
+}
+
+ostream &operator<<(ostream &Str, Branch const &b) {
+    Str << to_string(b.getType()) << " " << to_string(b.getNodeI()) << ","
+        << to_string(b.getNodeJ()) << " "<< to_string(b.getValue());
+    return Str;
+}
+
+void Circuit::findIslands() {
+    DisjointSets sets(noOfNodes + 1);
+    for (const Branch &b: branches)
+        if (b.getType() == 1 || b.getType() == 2) sets.unite(b.getNodeI(), b.getNodeJ());
+    vector<int> islandOf(noOfNodes + 1, -1); // island of every root of sets
+    islands.assign(noOfNodes + 1, -1);
+    islandRefs.clear();
+    int first = (refNode >= 1 && refNode <= noOfNodes) ? refNode : 1;
+    for (int q(0); q <= noOfNodes; q++) {
+        int p = q ? q : first; // refNode first, so its island is island 0 with refNode as its reference
+        if (p > noOfNodes || islands[p] >= 0) continue;
+        int &island = islandOf[sets.find(p)];
+        if (island < 0) {
+            island = (int) islandRefs.size();
+            islandRefs.push_back(p);
+        }
+        islands[p] = island;
+    }
+    unknowns.assign(noOfNodes + 1, -1);
+    int u = 0;
+    for (int p(1); p <= noOfNodes; p++)
+        if (islandRefs[islands[p]] != p) unknowns[p] = u++;
+}
+
+vector<int> Circuit::islandsOfUnknowns() {
+    vector<int> block(n + m, 0);
+    for (int p(1); p <= noOfNodes; p++)
+        if (unknown(p) >= 0) block[unknown(p)] = islands[p];
+    for (int k(0); k < m; k++) { // a voltage source belongs to the island of its nodes
+        int i = volSources.i[k] >= 0 ? volSources.i[k] : volSources.j[k];
+        if (i >= 0) block[n + k] = block[i];
+    }
+    return block;
+}
+
+void Circuit::bucketBranches() {
+    findIslands();
+    Bucket *buckets[] = {&resistors, &volSources, &currSources};
+    for (Bucket *bucket: buckets) *bucket = Bucket();
+    slots.assign(branches.size(), -1);
+    for (int k(0); k < branches.size(); k++) {
+        const Branch &b = branches[k];
+        if (b.getType() < 1 || b.getType() > 3) continue;
+        Bucket &bucket = *buckets[b.getType() - 1];
+        slots[k] = (int) bucket.i.size();
+        bucket.i.push_back(unknown(b.getNodeI()));
+        bucket.j.push_back(unknown(b.getNodeJ()));
+        bucket.value.push_back(b.getType() == 1 ? 1 / b.getValue() : b.getValue());
+    }
+}
+
+MatrixXd Circuit::admittances() {
+    MatrixXd G = MatrixXd::Zero(n, n);
+    const int *is = resistors.i.data(), *js = resistors.j.data();
+    const double *gs = resistors.value.data();
+    for (size_t k = 0; k < resistors.i.size(); k++) {
+        int i = is[k], j = js[k];
+        double g = gs[k];
+        if (i < 0 && j < 0) continue; // both ends at the reference node, carries no current
+        if (i < 0) {
+            G(j, j) += g;
+            continue;
+        }
+        if (j < 0) {
+            G(i, i) += g;
+            continue;
+        }
+        G(i, j) -= g;
+        G(j, i) -= g;
+        G(i, i) += g;
+        G(j, j) += g;
+    }
+    return G;
+}
+
+MatrixXd Circuit::volSourcesConnections() {
+    MatrixXd B = MatrixXd::Zero(n, m);
+    for (int k(0); k < m; k++) {
+        int i = volSources.i[k], j = volSources.j[k], v = (volSources.value[k] > 0) ? 1 : -1;
+        if (i >= 0) B(i, k) = -v;
+        if (j >= 0) B(j, k) = v;
+    }
+    return B;
+}
+
+MatrixXd Circuit::currentSources() {
+    MatrixXd I = MatrixXd::Zero(n, 1);
+    const int *is = currSources.i.data(), *js = currSources.j.data();
+    const double *vs = currSources.value.data();
+    for (size_t k = 0; k < currSources.i.size(); k++) {
+        if (is[k] >= 0) I(is[k], 0) -= vs[k];
+        if (js[k] >= 0) I(js[k], 0) += vs[k];
+    }
+    return I;
+}
+
+MatrixXd Circuit::voltageSources() {
+    MatrixXd e(m, 1);
+    for (int k(0); k < m; k++) e(k, 0) = abs(volSources.value[k]);
+    return e;
+}
+
+SparseMatrix<double> Circuit::sparseSystem() {
+    vector<Triplet<double>> triplets;
+    const int *is = resistors.i.data(), *js = resistors.j.data();
+    const double *gs = resistors.value.data();
+    auto stamp = [&](size_t from, size_t to, vector<Triplet<double>> &out) {
+        for (size_t k = from; k < to; k++) {
+            int i = is[k], j = js[k];
+            double g = gs[k];
+            if (i >= 0) out.emplace_back(i, i, g);
+            if (j >= 0) out.emplace_back(j, j, g);
+            if (i >= 0 && j >= 0) {
+                out.emplace_back(i, j, -g);
+                out.emplace_back(j, i, -g);
+            }
+        }
+    };
+    size_t noOfResistors = resistors.i.size();
+    int chunks = noOfChunks(noOfResistors, stampChunk);
+    if (chunks == 1) {
+        triplets.reserve(4 * noOfResistors + 4 * m);
+        stamp(0, noOfResistors, triplets);
+    } else { // joined in order, so duplicates are summed exactly as by one thread
+        vector<vector<Triplet<double>>> buffers(chunks);
+        forEachChunk(chunks, [&](int c) {
+            size_t from = noOfResistors * c / chunks, to = noOfResistors * (c + 1) / chunks;
+            buffers[c].reserve(4 * (to - from));
+            stamp(from, to, buffers[c]);
+        });
+        size_t size = 4 * m;
+        for (const vector<Triplet<double>> &buffer: buffers) size += buffer.size();
+        triplets.reserve(size);
+        for (const vector<Triplet<double>> &buffer: buffers) triplets.insert(triplets.end(), buffer.begin(), buffer.end());
+    }
+    for (int k(0); k < m; k++) {
+        int i = volSources.i[k], j = volSources.j[k], v = (volSources.value[k] > 0) ? 1 : -1;
+        if (i >= 0) {
+            triplets.emplace_back(i, n + k, -v);
+            triplets.emplace_back(n + k, i, -v);
+        }
+        if (j >= 0) {
+            triplets.emplace_back(j, n + k, v);
+            triplets.emplace_back(n + k, j, v);
+        }
+    }
+    SparseMatrix<double> A(n + m, n + m);
+    A.setFromTriplets(triplets.begin(), triplets.end());
+    return A;
+}
+
+bool Circuit::solveReduced() {
+    PhaseTimer timer(stats, SolverStats::Reduction);
+    n = nodeUnknowns(), m = noOfVolSources();
+    int ground = n;
+    DisjointSets trees(n + 1);
+    vector<vector<int>> sourcesAt(n + 1);
+    for (int k(0); k < m; k++) {
+        int i = volSources.i[k] < 0 ? ground : volSources.i[k], j = volSources.j[k] < 0 ? ground : volSources.j[k];
+        if (trees.find(i) == trees.find(j)) return false;
+        trees.unite(i, j);
+        sourcesAt[i].push_back(k);
+        sourcesAt[j].push_back(k);
+    }
+    // V_p = y[reduced[p]] + offset[p], reduced is -1 for nodes fixed by grounded sources
+    vector<int> reduced(n + 1, -2), order, parentSource(n + 1, -1);
+    vector<double> offset(n + 1, 0);
+    order.reserve(n + 1);
+    int q = 0;
+    for (int r(-1); r < n; r++) { // the reference node first, so its tree is grounded
+        int root = (r < 0) ? ground : r;
+        if (reduced[root] != -2) continue;
+        reduced[root] = (root == ground) ? -1 : q++;
+        size_t first = order.size();
+        order.push_back(root);
+        for (size_t o = first; o < order.size(); o++) {
+            int p = order[o];
+            for (int k: sourcesAt[p]) {
+                if (k == parentSource[p]) continue;
+                int i = volSources.i[k] < 0 ? ground : volSources.i[k], j = volSources.j[k] < 0 ? ground : volSources.j[k];
+                int c = (i == p) ? j : i;
+                reduced[c] = reduced[root];
+                offset[c] = offset[p] + ((c == j) ? volSources.value[k] : -volSources.value[k]); // V_j - V_i = E
+                parentSource[c] = k;
+                order.push_back(c);
+            }
+        }
+    }
+
+    vector<Triplet<double>> triplets;
+    triplets.reserve(4 * resistors.i.size());
+    VectorXd rhs = VectorXd::Zero(q);
+    auto node = [ground](int p) { return p < 0 ? ground : p; };
+    for (size_t k = 0; k < resistors.i.size(); k++) {
+        int i = node(resistors.i[k]), j = node(resistors.j[k]), ri = reduced[i], rj = reduced[j];
+        double g = resistors.value[k], fixed = g * (offset[i] - offset[j]);
+        if (ri == rj) continue; // inside one supernode
+        if (ri >= 0) {
+            triplets.emplace_back(ri, ri, g);
+            rhs(ri) -= fixed;
+        }
+        if (rj >= 0) {
+            triplets.emplace_back(rj, rj, g);
+            rhs(rj) += fixed;
+        }
+        if (ri >= 0 && rj >= 0) {
+            triplets.emplace_back(ri, rj, -g);
+            triplets.emplace_back(rj, ri, -g);
+        }
+    }
+    for (size_t k = 0; k < currSources.i.size(); k++) {
+        int ri = reduced[node(currSources.i[k])], rj = reduced[node(currSources.j[k])];
+        if (ri >= 0) rhs(ri) -= currSources.value[k];
+        if (rj >= 0) rhs(rj) += currSources.value[k];
+    }
+    VectorXd y(q);
+    if (q > 0) {
+        SparseMatrix<double> A(q, q);
+        A.setFromTriplets(triplets.begin(), triplets.end());
+        MnaSolver reducedSolver = q <= denseLimit ? MnaSolver(MatrixXd(A)) :
+                                  positiveDefinite(q) ? MnaSolver(A, tolerance) : MnaSolver(A, precision);
+        y = reducedSolver.solve(rhs, lastSolution, stats.iterations);
+        if (reducedSolver.isIterative()) lastSolution = y;
+        stats.unknowns = q;
+        stats.nonZeros = A.nonZeros();
+        stats.singlePrecision = reducedSolver.isMixed();
+        stats.fillIn = reducedSolver.factorNonZeros() - (reducedSolver.isIterative() ? (A.nonZeros() + q) / 2 : A.nonZeros());
+    }
+
+    VectorXd v(n + 1);
+    for (int p(0); p <= n; p++) v(p) = (reduced[p] >= 0 ? y(reduced[p]) : 0) + offset[p];
+    // what the sources have to deliver into every node: B iv = i - G v
+    VectorXd rest = VectorXd::Zero(n + 1);
+    for (size_t k = 0; k < currSources.i.size(); k++) {
+        rest(node(currSources.i[k])) -= currSources.value[k];
+        rest(node(currSources.j[k])) += currSources.value[k];
+    }
+    for (size_t k = 0; k < resistors.i.size(); k++) {
+        int i = node(resistors.i[k]), j = node(resistors.j[k]);
+        double current = resistors.value[k] * (v(i) - v(j));
+        rest(i) -= current;
+        rest(j) += current;
+    }
+    volSourcesCurrents.assign(m, 0);
+    for (size_t o = order.size(); o-- > 0;) {
+        int c = order[o], k = parentSource[c];
+        if (k < 0) continue;
+        int i = node(volSources.i[k]), sign = (volSources.value[k] > 0) ? 1 : -1;
+        int bc = (c == i) ? -sign : sign; // B(c, k)
+        volSourcesCurrents[k] = rest(c) / bc;
+        rest(c == i ? node(volSources.j[k]) : i) -= -bc * volSourcesCurrents[k]; // B(parent, k) = -B(c, k)
+    }
+    nodesVoltages.assign(noOfNodes, 0);
+    for (int p(1); p <= noOfNodes; p++) {
+        int u = unknown(p);
+        nodesVoltages[p - 1] = u < 0 ? 0 : v(u);
+    }
+    return true;
+}
+
+void Circuit::countK(vector<Branch> &vecB) {
+    unordered_map<long long, int> parallel, k;
+    for (const Branch &b: vecB)
+        parallel[nodePair(b.getNodeI(), b.getNodeJ())]++;
+    for (Branch &b: vecB) {
+        long long pair = nodePair(b.getNodeI(), b.getNodeJ());
+        if (parallel[pair] > 1) b.setBranchK(++k[pair]);
+    }
+}
+
+vector<Branch> Circuit::branchesFromTxt(const vector<Element> &elements, bool withAmmeters) {
+    vector<int> is, js; // indices of the end points, positions are hashed only once
+    unordered_map<long long, int> points;
+    auto point = [&points](int x, int y) {
+        long long key = (long long) ((unsigned long long) (unsigned) x << 32 | (unsigned) y);
+        return points.emplace(key, (int) points.size()).first->second;
+    };
+    vector<Branch> vecB;
+    int num = 1;
+
+    if (elements.empty()) throw logic_error("Prazan krug");
+    is.reserve(elements.size());
+    js.reserve(elements.size());
+    for (const Element &e: elements) {
+        is.push_back(point(e.xI, e.yI));
+        js.push_back(point(e.xJ, e.yJ));
+    }
+
+    int ammeter = 5, wattmeter = 8;
+    if (withAmmeters) {
+        ammeter = -1;
+        wattmeter = -1;
+    }
+
+    // making one point for same potential
+    DisjointSets potentials((int) points.size());
+    for (int k(0); k < elements.size(); k++) {
+        int type = elements[k].type;
+        if (type == 0 || type == ammeter || type == wattmeter)
+            potentials.unite(is[k], js[k]);
+    }
+    if (withAmmeters) {
+        ammeter = 4;
+        wattmeter = 7;
+    }
+    // numbering points beginning from 1, in order of first appearance, skipping wires
+    vector<int> numbers(points.size(), 0);
+    for (int k(0); k < elements.size(); k++) {
+        int type = elements[k].type;
+        if (type == 0 || type == ammeter || type == wattmeter) continue;
+        int &numI = numbers[potentials.find(is[k])];
+        if (numI == 0) numI = num++;
+        int &numJ = numbers[potentials.find(js[k])];
+        if (numJ == 0) numJ = num++;
+        Branch branch(numI, numJ, 0, type, elements[k].value);
+        vecB.push_back(branch);
+    }
+    if (!withAmmeters) noOfNodes = num - 1;
+    countK(vecB);
+    return vecB;
+}
+
+Circuit::Circuit(const vector<Element> &elements) {
+    build(elements);
+}
+
+Circuit::Circuit(const string &fileName, bool useCache, bool statistics) {
+    stats.enabled = statistics;
+    vector<Element> elements;
+    if (!useCache || fileName == "-") {
+        {
+            PhaseTimer timer(stats, SolverStats::Parse);
+            elements = readNetlistFile(fileName);
+        }
+        build(elements);
+        return;
+    }
+    MappedFile source(fileName);
+    uint64_t hash = contentHash(source.text());
+    string cacheFile = fileName + ".dcc";
+    if (access(cacheFile.c_str(), R_OK) == 0) {
+        PhaseTimer timer(stats, SolverStats::Cache);
+        MappedFile cache(cacheFile);
+        if (loadCompiled(cache.text(), hash)) return;
+    }
+    {
+        PhaseTimer timer(stats, SolverStats::Parse);
+        elements = readNetlist(source.text());
+    }
+    build(elements);
+    saveCompiled(cacheFile, hash);
+}
+
+void Circuit::build(const vector<Element> &elements) {
+    PhaseTimer timer(stats, SolverStats::Merge);
+    vector<Branch> vecB = branchesFromTxt(elements, false);
+    setBranches(vecB);
+    meterBranches = branchesFromTxt(elements, true);
+    placeMeters();
+    solved = false;
+}
+
+void Circuit::setRefNode(int rNode) {
+    if (rNode < 1 || rNode > noOfNodes) throw out_of_range("Reference node out of boundaries");
+    PhaseTimer timer(stats, SolverStats::Reference);
+    Circuit::refNode = rNode;
+    bucketBranches();
+    solver.reset();
+    fixedFactorized = false;
+    portModels.clear();
+    for (Branch branch: branches) {
+        if (branch.getNodeI() == rNode) {
+            branch.setNodeI(0);
+        } else if (branch.getNodeJ() == rNode) {
+            branch.setNodeJ(branch.getNodeI());
+            branch.setNodeI(0);
+            if (branch.getType() != 1) branch.setValue(-branch.getValue());
+        }
+    }
+    solved = false;
+}
+
+void Circuit::setBranches(const vector<Branch> &vecB) {
+    Circuit::branches = vecB;
+    noRefBranches = vecB;
+    components.clear();
+    for (int k(0); k < vecB.size(); k++)
+        if (vecB[k].getType() <= 3) components.push_back(k);
+    bucketBranches();
+    solver.reset();
+    fixedFactorized = false;
+    portModels.clear();
+}
+
+void Circuit::factorize() {
+    n = nodeUnknowns(), m = noOfVolSources();
+    bool reuse = solver && solver.use_count() == 1; // not shared with a copy of this circuit
+    stale = false;
+    stats.unknowns = n + m;
+    if (n + m <= denseLimit) {
+        MatrixXd G(n, n), B(n, m), D = MatrixXd::Zero(m, m), A(n+m, n+m);
+        {
+            PhaseTimer timer(stats, SolverStats::Assembly);
+            G = admittances();
+            B = volSourcesConnections();
+            A << G,             B,
+                 B.transpose(), D;
+        }
+        PhaseTimer timer(stats, SolverStats::Factorization);
+        if (reuse) solver->refactorize(A);
+        else solver = make_shared<MnaSolver>(A);
+        stats.nonZeros = (A.array() != 0).count();
+    } else {
+        SparseMatrix<double> A;
+        {
+            PhaseTimer timer(stats, SolverStats::Assembly);
+            A = sparseSystem();
+        }
+        PhaseTimer timer(stats, SolverStats::Factorization);
+        bool iterative = m == 0 && positiveDefinite(n);
+        if (reuse && solver->isIterative() == iterative) solver->refactorize(A);
+        else if (iterative) solver = make_shared<MnaSolver>(A, tolerance);
+        else if (islandRefs.size() > 1) solver = make_shared<MnaSolver>(A, islandsOfUnknowns(), precision);
+        else solver = make_shared<MnaSolver>(A, precision);
+        stats.nonZeros = A.nonZeros();
+    }
+    stats.singlePrecision = solver->isMixed();
+    stats.fillIn = solver->factorNonZeros() - (solver->isIterative() ? (stats.nonZeros + n) / 2 : stats.nonZeros);
+}
+
+SparseMatrix<double> Circuit::systemMatrix() {
+    n = nodeUnknowns(), m = noOfVolSources();
+    return sparseSystem();
+}
+
+void Circuit::setComponentValue(int c, double value) {
+    if (c < 0 || c >= components.size()) throw out_of_range("Component out of boundaries");
+    Branch &b = branches[components[c]];
+    int slot = slots[components[c]];
+    if (b.getType() == 1) { // a resistor is a rank-one change of A, kept by the solver until there are too many
+        stale = stale || !solver || solver.use_count() > 1 ||
+                !solver->update(components[c], resistors.i[slot], resistors.j[slot], resistors.value[slot],
+                                1 / value, updateLimit);
+        if (fixedFactorized) updateFixed(resistors.i[slot], resistors.j[slot], 1 / value - resistors.value[slot]);
+        resistors.value[slot] = 1 / value;
+    } else {
+        if (b.getType() == 2 && (b.getValue() > 0) != (value > 0)) { // the sign of the source is kept in A
+            stale = true;
+            fixedFactorized = false;
+        }
+        (b.getType() == 2 ? volSources : currSources).value[slot] = value;
+    }
+    b.setValue(value);
+    noRefBranches[components[c]].setValue(value);
+    portModels.clear();
+    solved = false;
+}
+
+MatrixXd Circuit::rightHandSide() {
+    if (!solver || stale) factorize();
+    MatrixXd i(n, 1), e(m, 1), b(n+m, 1);
+    i = currentSources();
+    e = voltageSources();
+    b << i, e;
+    return b;
+}
+
+VectorXd Circuit::sourceValues() {
+    vector<double> values;
+    for (const Branch &b: branches)
+        if (b.getType() == 2 || b.getType() == 3) values.push_back(b.getValue());
+    return Eigen::Map<VectorXd>(values.data(), (long) values.size());
+}
+
+MatrixXd Circuit::sourceScenarios(const MatrixXd &values) {
+    if (!solver || stale) factorize();
+    MatrixXd b = MatrixXd::Zero(n + m, values.cols());
+    int s = 0;
+    for (int k: components) {
+        int type = branches[k].getType(), slot = slots[k];
+        if (type == 1) continue;
+        if (s >= values.rows()) throw out_of_range("Not enough source values in scenario");
+        if (type == 2) { // A holds the sign of the original source, so only |e| goes to b
+            b.row(n + slot) = (volSources.value[slot] > 0 ? 1 : -1) * values.row(s++);
+            continue;
+        }
+        int i = currSources.i[slot], j = currSources.j[slot];
+        if (i >= 0) b.row(i) -= values.row(s);
+        if (j >= 0) b.row(j) += values.row(s);
+        s++;
+    }
+    return b;
+}
+
+Solutions Circuit::solveScenarios(const MatrixXd &b) {
+    if (!solver || stale) factorize();
+    PhaseTimer timer(stats, SolverStats::Substitution);
+    MatrixXd x = solver->solve(b, lastSolution, stats.iterations);
+    if (solver->isIterative()) lastSolution = x;
+    Solutions sol;
+    sol.nodesVoltages.resize(noOfNodes, b.cols());
+    for (int p(1); p <= noOfNodes; p++) {
+        if (unknown(p) < 0) sol.nodesVoltages.row(p - 1).setZero();
+        else sol.nodesVoltages.row(p - 1) = x.row(unknown(p));
+    }
+    sol.volSourcesCurrents = x.bottomRows(m);
+    return sol;
+}
+
+void Circuit::solve() {
+    if (reducedSources && solveReduced()) {
+        solved = true;
+        return;
+    }
+    if (solveSmall()) {
+        solved = true;
+        return;
+    }
+    Solutions sol = solveScenarios(rightHandSide());
+    MatrixXd vn = sol.nodesVoltages, iv = sol.volSourcesCurrents;
+    vector<double> vecVn(vn.data(), vn.data() + vn.size());
+    vector<double> vecIv(iv.data(), iv.data() + iv.size());
+    nodesVoltages = vecVn;
+    volSourcesCurrents = vecIv;
+    solved = true;
+}
+
+vector<double> Circuit::getBranchesCurrents() {
+    if (!solved) throw logic_error("Circuit is not solved yet");
+    vector<double> currents;
+    int vx = 0;
+    for (Branch b: noRefBranches) {
+        if (b.getType() == 3)
+            currents.push_back(b.getValue());
+        else if (b.getType() == 2) {
+            if (b.getValue() > 0) currents.push_back(-volSourcesCurrents[vx++]);
+            else currents.push_back(volSourcesCurrents[vx++]);
+        } else if (b.getType() == 1) {
+            double vi = nodesVoltages[b.getNodeI() - 1], vj = nodesVoltages[b.getNodeJ() - 1];
+            currents.push_back((vi - vj) / b.getValue());
+        }
+    }
+    return currents;
+}
+
+vector<double> Circuit::voltmetersVoltages(int type) {
+    vector<double> voltages;
+    for (const Branch &b: noRefBranches) {
+        if (b.getType() == type) {
+            int vi = b.getNodeI(), vj = b.getNodeJ();
+            double voltage = nodesVoltages[vi - 1] - nodesVoltages[vj - 1];
+            if (islands[vi] != islands[vj]) voltage = numeric_limits<double>::quiet_NaN(); // nothing connects them
+            voltages.push_back(voltage);
+        }
+    }
+    return voltages;
+}
+
+void Circuit::placeMeters() {
+    int noOfMeterNodes = 0;
+    for (const Branch &b: meterBranches) noOfMeterNodes = max({noOfMeterNodes, b.getNodeI(), b.getNodeJ()});
+    vector<int> start(noOfMeterNodes + 2, 0), incident;
+    for (const Branch &b: meterBranches) {
+        start[b.getNodeI() + 1]++;
+        if (b.getNodeJ() != b.getNodeI()) start[b.getNodeJ() + 1]++;
+    }
+    for (int k(1); k < start.size(); k++) start[k] += start[k - 1];
+    incident.resize(start.back());
+    vector<int> fill(start.begin(), start.end() - 1);
+    for (int l(0); l < meterBranches.size(); l++) {
+        int li = meterBranches[l].getNodeI(), lj = meterBranches[l].getNodeJ();
+        incident[fill[li]++] = l;
+        if (lj != li) incident[fill[lj]++] = l;
+    }
+
+    meters.clear();
+    meterTerms.clear();
+    meterStart.assign(1, 0);
+    auto isMeter = [this](int l) { return meterBranches[l].getType() == 5 || meterBranches[l].getType() == 8; };
+    auto place = [this](int k) {
+        meters.push_back(k);
+        meterStart.push_back((int) meterTerms.size());
+        meterBranches[k].setType(meterBranches[k].getType() + 1);
+    };
+    for (int k(0); k < meterBranches.size(); k++) { // Ammeters in series with other components
+        if (!isMeter(k)) continue;
+        int ki = meterBranches[k].getNodeI(), kj = meterBranches[k].getNodeJ();
+        for (int end(0); end < 2; end++) {
+            int node = end ? kj : ki, connections = 0, index = 0;
+            for (int p = start[node]; p < start[node + 1]; p++) {
+                if (incident[p] == k) continue;
+                index = incident[p];
+                connections++;
+            }
+            if (connections != 1) continue;
+            const Branch &l = meterBranches[index];
+            int sign = (end ? l.getNodeJ() == kj : l.getNodeI() == ki) ? -1 : 1;
+            meterTerms.push_back({index, sign});
+            place(k);
+            break;
+        }
+    }
+    for (int k(0); k < meterBranches.size(); k++) { // Ammeters alone in a wire
+        if (!isMeter(k)) continue;
+        int ki = meterBranches[k].getNodeI(), kj = meterBranches[k].getNodeJ();
+        for (int end(0); end < 2; end++) {
+            int node = end ? kj : ki;
+            bool alone = true;
+            for (int p = start[node]; p < start[node + 1]; p++)
+                if (incident[p] != k && isMeter(incident[p])) alone = false;
+            if (!alone) continue;
+            for (int p = start[node]; p < start[node + 1]; p++) {
+                int l = incident[p];
+                if (l == k) continue;
+                bool out = end ? meterBranches[l].getNodeJ() != kj : meterBranches[l].getNodeI() == ki;
+                meterTerms.push_back({l, out ? -1 : 1});
+            }
+            place(k);
+            break;
+        }
+    }
+}
+
+vector<double> Circuit::currentsWithMeters() {
+    vector<double> branchesCurrents = getBranchesCurrents(), currents(meterBranches.size(), 0);
+    int c = 0;
+    for (int k(0); k < meterBranches.size(); k++)
+        if (meterBranches[k].getType() <= 3) currents[k] = branchesCurrents[c++];
+    for (int k(0); k < meters.size(); k++) {
+        double current = 0;
+        for (int t = meterStart[k]; t < meterStart[k + 1]; t++)
+            current += meterTerms[t].sign * currents[meterTerms[t].branch];
+        currents[meters[k]] = current;
+    }
+    return currents;
+}
+
+Readings Circuit::readings() {
+    if (!solved) throw logic_error("Circuit is not solved yet");
+    const vector<Branch> &newBranches = meterBranches;
+    vector<double> currents = currentsWithMeters(), wattmetersVoltages = voltmetersVoltages(7);
+    Readings r;
+    r.voltmeters = voltmetersVoltages();
+    for (int k(0); k < currents.size(); k++) {
+        if (newBranches[k].getType() == 6) r.ammeters.push_back(currents[k]);
+        else if (newBranches[k].getType() == 9)
+            r.wattmeters.push_back(currents[k] * wattmetersVoltages[r.wattmeters.size()]);
+    }
+    return r;
+}
+
+Sensitivities Circuit::sensitivities() {
+    if (!solved) throw logic_error("Circuit is not solved yet");
+    if (!solver || stale) factorize();
+    PhaseTimer timer(stats, SolverStats::Sensitivities);
+    int noOfComponents = (int) components.size();
+    VectorXd x(n + m);
+    for (int p(1); p <= noOfNodes; p++)
+        if (unknown(p) >= 0) x(unknown(p)) = nodesVoltages[p - 1];
+    for (int k(0); k < m; k++) x(n + k) = volSourcesCurrents[k];
+    auto at = [&x](int u) { return u < 0 ? 0.0 : x(u); };
+
+    // every reading as g^T x + h^T p, with x the unknowns and p the component values
+    struct Linear {
+        VectorXd g, h;
+    };
+    auto zero = [&]() { return Linear{VectorXd::Zero(n + m), VectorXd::Zero(noOfComponents)}; };
+    auto addCurrent = [&](Linear &y, int c, double sign) { // current of component c as in getBranchesCurrents
+        int slot = slots[components[c]], type = branches[components[c]].getType();
+        if (type == 1) { // (x_i - x_j) g, d/dR = -(x_i - x_j) g^2
+            int i = resistors.i[slot], j = resistors.j[slot];
+            double g = resistors.value[slot];
+            if (i >= 0) y.g(i) += sign * g;
+            if (j >= 0) y.g(j) -= sign * g;
+            y.h(c) -= sign * g * g * (at(i) - at(j));
+        } else if (type == 2) y.g(n + slot) += volSources.value[slot] > 0 ? -sign : sign;
+        else y.h(c) += sign;
+    };
+    auto addVoltage = [&](Linear &y, int vi, int vj, double sign) {
+        if (unknown(vi) >= 0) y.g(unknown(vi)) += sign;
+        if (unknown(vj) >= 0) y.g(unknown(vj)) -= sign;
+    };
+
+    vector<int> component(meterBranches.size(), -1); // of every resistor and source of meterBranches
+    for (int k(0), c(0); k < meterBranches.size(); k++)
+        if (meterBranches[k].getType() <= 3) component[k] = c++;
+    map<int, Linear> meterCurrents; // same order of evaluation as currentsWithMeters
+    for (int k(0); k < meters.size(); k++) {
+        Linear y = zero();
+        for (int t = meterStart[k]; t < meterStart[k + 1]; t++) {
+            int l = meterTerms[t].branch, sign = meterTerms[t].sign;
+            if (component[l] >= 0) addCurrent(y, component[l], sign);
+            else if (meterCurrents.count(l)) {
+                y.g += sign * meterCurrents[l].g;
+                y.h += sign * meterCurrents[l].h;
+            }
+        }
+        meterCurrents[meters[k]] = y;
+    }
+
+    vector<Linear> ys;
+    vector<bool> across; // voltages between two islands, without derivatives
+    vector<int> voltmeters, wattmeterCoils;
+    for (const Branch &b: noRefBranches) {
+        if (b.getType() != 4 && b.getType() != 7) continue;
+        Linear y = zero();
+        addVoltage(y, b.getNodeI(), b.getNodeJ(), 1);
+        (b.getType() == 4 ? voltmeters : wattmeterCoils).push_back((int) ys.size());
+        across.push_back(islands[b.getNodeI()] != islands[b.getNodeJ()]);
+        ys.push_back(y);
+    }
+    vector<int> ammeters, wattmeters;
+    vector<double> currents = currentsWithMeters();
+    for (int k(0); k < meterBranches.size(); k++) {
+        int type = meterBranches[k].getType();
+        if (type != 6 && type != 9) continue;
+        Linear y = meterCurrents.count(k) ? meterCurrents[k] : zero();
+        bool isAcross = false;
+        if (type == 9) { // P = I U, dP = U dI + I dU
+            int coil = wattmeterCoils[wattmeters.size()];
+            double voltage = ys[coil].g.dot(x);
+            y.g = voltage * y.g + currents[k] * ys[coil].g;
+            y.h *= voltage;
+            isAcross = across[coil];
+        }
+        (type == 6 ? ammeters : wattmeters).push_back((int) ys.size());
+        across.push_back(isAcross);
+        ys.push_back(y);
+    }
+
+    int noOfVoltmeters = (int) voltmeters.size(), noOfAmmeters = (int) ammeters.size();
+    int noOfWattmeters = (int) wattmeters.size(), noOfReadings = noOfVoltmeters + noOfAmmeters + noOfWattmeters;
+    vector<int> rows(voltmeters); // rows of ys in the order of Readings
+    rows.insert(rows.end(), ammeters.begin(), ammeters.end());
+    rows.insert(rows.end(), wattmeters.begin(), wattmeters.end());
+    MatrixXd g(n + m, noOfReadings);
+    for (int r(0); r < noOfReadings; r++) g.col(r) = across[rows[r]] ? VectorXd::Zero(n + m) : ys[rows[r]].g;
+    MatrixXd lambda = solver->solve(g); // A^T = A
+    MatrixXd s(noOfReadings, noOfComponents);
+    for (int r(0); r < noOfReadings; r++) {
+        if (across[rows[r]]) {
+            s.row(r).setConstant(numeric_limits<double>::quiet_NaN());
+            continue;
+        }
+        s.row(r) = ys[rows[r]].h.transpose();
+        for (int c(0); c < noOfComponents; c++) {
+            int slot = slots[components[c]], type = branches[components[c]].getType();
+            auto la = [&](int u) { return u < 0 ? 0.0 : lambda(u, r); };
+            if (type == 1) { // dA/dR = -g^2 (e_i - e_j)(e_i - e_j)^T
+                int i = resistors.i[slot], j = resistors.j[slot];
+                double gc = resistors.value[slot];
+                s(r, c) += gc * gc * (la(i) - la(j)) * (at(i) - at(j));
+            } else if (type == 2) s(r, c) += (volSources.value[slot] > 0 ? 1 : -1) * lambda(n + slot, r);
+            else s(r, c) += la(currSources.j[slot]) - la(currSources.i[slot]);
+        }
+    }
+    Sensitivities sens;
+    sens.voltmeters = s.topRows(noOfVoltmeters);
+    sens.ammeters = s.middleRows(noOfVoltmeters, noOfAmmeters);
+    sens.wattmeters = s.bottomRows(noOfWattmeters);
+    return sens;
+}
+
+vector<int> Circuit::floatingIslands() const {
+    // resistors and sources are in branches and meterBranches in the same order, only the nodes are numbered
+    // differently (meters are wires in branches), so the first component at a reference node gives its number
+    vector<int> meterComponents, refs;
+    for (int k(0); k < meterBranches.size(); k++)
+        if (meterBranches[k].getType() <= 3) meterComponents.push_back(k);
+    for (int island(1); island < islandRefs.size(); island++) {
+        int p = islandRefs[island];
+        for (int c(0); c < components.size() && c < meterComponents.size(); c++) {
+            const Branch &b = branches[components[c]], &meterB = meterBranches[meterComponents[c]];
+            if (b.getNodeI() != p && b.getNodeJ() != p) continue;
+            refs.push_back(b.getNodeI() == p ? meterB.getNodeI() : meterB.getNodeJ());
+            break;
+        }
+    }
+    return refs;
+}
+
+int Circuit::circuitNode(int node) const {
+    int c = 0; // resistors and sources come in the same order in branches and meterBranches
+    for (const Branch &meterB: meterBranches) {
+        if (meterB.getType() > 3) continue;
+        const Branch &b = branches[components[c++]];
+        if (meterB.getNodeI() == node) return b.getNodeI();
+        if (meterB.getNodeJ() == node) return b.getNodeJ();
+    }
+    throw out_of_range("Node " + to_string(node) + " has no resistor or source");
+}
+
+const PortModel &Circuit::portModel(const vector<int> &ports) {
+    auto cached = portModels.find(ports);
+    if (cached != portModels.end()) return cached->second;
+    if (!solver || stale) factorize();
+    long k = (long) ports.size();
+    vector<int> us;
+    for (int port: ports) {
+        int p = meterBranches.empty() ? port : circuitNode(port);
+        if (p < 1 || p > noOfNodes) throw out_of_range("Port out of boundaries");
+        if (islands[p] != 0) throw logic_error("Port " + to_string(port) + " is not connected to the reference node");
+        us.push_back(unknown(p));
+    }
+    MatrixXd b(n + m, 1 + k); // the sources of the circuit, then a unit current into every port
+    b << rightHandSide(), MatrixXd::Zero(n + m, k);
+    for (int q(0); q < k; q++)
+        if (us[q] >= 0) b(us[q], 1 + q) = 1;
+    MatrixXd x = solver->solve(b);
+    PortModel model;
+    model.ports = ports;
+    model.openVoltages = VectorXd::Zero(k);
+    model.impedances = MatrixXd::Zero(k, k);
+    for (int q(0); q < k; q++) {
+        if (us[q] < 0) continue; // the reference node itself
+        model.openVoltages(q) = x(us[q], 0);
+        for (int r(0); r < k; r++) model.impedances(q, r) = x(us[q], 1 + r);
+    }
+    return portModels[ports] = model;
+}
+
+Results Circuit::results() {
+    if (!solved) throw logic_error("Circuit is not solved yet");
+    vector<double> currents = currentsWithMeters(), wattmetersVoltages = voltmetersVoltages(7);
+    Results r;
+    r.readings.voltmeters = voltmetersVoltages();
+    r.noOfAmmeters = 0;
+    r.noOfWattmeters = (int) wattmetersVoltages.size();
+    r.floatingIslands = floatingIslands();
+    if (reportSensitivities) r.sensitivities = sensitivities();
+    for (int k(0); k < currents.size(); k++) {
+        const Branch &b = meterBranches[k];
+        if (b.getType() <= 3) r.branches.push_back({b.getNodeI(), b.getNodeJ(), b.getBranchK(), b.getType(), currents[k]});
+        if (b.getType() == 5 || b.getType() == 6) r.noOfAmmeters++;
+        if (b.getType() == 6) r.readings.ammeters.push_back(currents[k]);
+        else if (b.getType() == 9)
+            r.readings.wattmeters.push_back(currents[k] * wattmetersVoltages[r.readings.wattmeters.size()]);
+    }
+    return r;
+}
+
+void Circuit::printVoltmeters(ostream &out) {
+    ResultWriter(out, ResultFormat::Text).writeVoltmeters(results());
+}
+
+void Circuit::printCurrents(ostream &out) {
+    ResultWriter(out, ResultFormat::Text).writeCurrents(results());
+}
+
+void Circuit::printSolution(ostream &out) {
+    writeSolution(out, ResultFormat::Text);
+}
+
+void Circuit::writeSolution(ostream &out, ResultFormat format) {
+    if (!solved) throw logic_error("Circuit is not solved yet");
+    PhaseTimer timer(stats, SolverStats::Print);
+    ResultWriter(out, format).write(results());
+}
+
+const SolverStats &Circuit::statistics() {
+    stats.nodes = noOfNodes;
+    stats.branches = (long) branches.size();
+    stats.volSources = noOfVolSources();
+    stats.islands = (long) islandRefs.size();
+    if (!solved || nodesVoltages.size() != noOfNodes || volSourcesCurrents.size() != noOfVolSources()) return stats;
+    n = nodeUnknowns(), m = noOfVolSources();
+    VectorXd x(n + m), b(n + m);
+    for (int p(1); p <= noOfNodes; p++)
+        if (unknown(p) >= 0) x(unknown(p)) = nodesVoltages[p - 1];
+    for (int k(0); k < m; k++) x(n + k) = volSourcesCurrents[k];
+    b << currentSources(), voltageSources();
+    stats.residual = (sparseSystem() * x - b).lpNorm<Eigen::Infinity>();
+    return stats;
+}
@@ -0,0 +1,215 @@
+#ifndef DCCALCULATOR_CIRCUIT_H
+#define DCCALCULATOR_CIRCUIT_H
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include "MnaSolver.h"
+#include "Netlist.h"
+#include "PortModel.h"
+#include "SolverStats.h"
+
+class Branch {
+    int nodeI, nodeJ, branchK, type;
+    // type = 1 for R:resistor, 2 - E:volSource, 3 - Is:currSource, 4 - Uv:voltmeter, 5 - Ia:ammeter,
+    // 6 - calculated ammeter, 7 - Wv: voltage of wattmeter, 8 - Wa: current of wattmeter, 9 - calculated Wa
+    double value;
+public:
+    Branch(int nodeI, int nodeJ, int branchK, int type, double value) : nodeI(nodeI), nodeJ(nodeJ), branchK(branchK),
+                                                                        type(type), value(value) {}
+    int getNodeI() const { return nodeI; }
+    int getNodeJ() const { return nodeJ; }
+    int getBranchK() const { return branchK; }
+    int getType() const { return type; }
+    double getValue() const { return value; }
+
+    void setNodeI(int nI) { Branch::nodeI = nI; }
+    void setNodeJ(int nJ) { Branch::nodeJ = nJ; }
+    void setBranchK(int bK) { Branch::branchK = bK; }
+    void setType(int t) { Branch::type = t; }
+    void setValue(double v) { Branch::value = v; }
+};
+
+std::string fixed3(double x); // same as printf("%.3lf")
+std::ostream &operator<<(std::ostream &Str, Branch const &b);
+
+struct Solutions { // one column per right-hand side
+    Eigen::MatrixXd nodesVoltages, volSourcesCurrents;
+};
+
+struct Readings { // meter readings in V, A and W, in the order of Uv_k, Ia_k and Pw_k
+    std::vector<double> voltmeters, ammeters, wattmeters;
+};
+
+struct Sensitivities { // d(reading)/d(value), a row per reading of Readings, a column per component
+    Eigen::MatrixXd voltmeters, ammeters, wattmeters; // in V, A and W per Ω, V or A of the component
+};
+
+struct BranchCurrent { // current of a resistor or source in A, printed as I_nodeI_nodeJ(_branchK)
+    int nodeI, nodeJ, branchK, type;
+    double current;
+};
+
+struct Results { // everything printSolution reports
+    std::vector<BranchCurrent> branches;
+    Readings readings; // voltmeters between two islands read NaN
+    int noOfAmmeters, noOfWattmeters; // including meters whose current could not be found
+    std::vector<int> floatingIslands; // reference nodes of islands not connected to the reference node
+    Sensitivities sensitivities; // empty unless the circuit reports them
+};
+
+enum class ResultFormat; // ResultWriter.h
+
+class Circuit {
+    int noOfNodes{}, refNode{}, n{}, m{};
+    bool solved, stale{}; // stale: values in A changed since the last factorization
+    bool reducedSources{};
+    bool reportSensitivities{};
+    Precision precision = Precision::Double; // of sparse LU factorizations
+    static const int denseLimit = 32; // n+m up to this is still solved through the dense inverse
+    static const int updateLimit = 16; // resistor changes solved through the previous factorization
+    static const int stampChunk = 1 << 16; // resistors stamped by one thread of assembly, at least
+    static const int fixedLimit = 16; // n+m up to this is solved with fixed-size matrices, without heap allocation
+    std::array<double, fixedLimit * fixedLimit> fixedInverse{}; // inverse of A, column-major, for n+m <= fixedLimit
+    bool fixedFactorized{};
+    int fixedUpdates{}; // rank-one updates of fixedInverse since it was computed
+    int iterativeLimit = 10000; // systems without voltage sources from this size on are solved iteratively
+    double tolerance = 1e-10;
+    Eigen::MatrixXd lastSolution; // x of the last iterative solve, where the next one starts from
+    std::vector<double> nodesVoltages, volSourcesCurrents;
+    std::vector<Branch> branches, noRefBranches;
+    std::vector<Branch> meterBranches; // the netlist with its ammeters and wattmeters, numbered on its own
+    struct MeterTerm { int branch, sign; };
+    std::vector<int> meters, meterStart; // meters in order of evaluation, their terms start at meterStart
+    std::vector<MeterTerm> meterTerms;
+    std::shared_ptr<MnaSolver> solver; // reset whenever the structure of A changes
+    std::vector<int> components; // indices of resistors and sources in branches
+    struct Bucket { // branches of one type as structure of arrays, nodes as unknowns (-1 for the reference node)
+        std::vector<int> i, j;
+        std::vector<double> value; // conductance of a resistor, value of a source
+    };
+    Bucket resistors, volSources, currSources;
+    std::vector<int> slots; // position of every branch in its bucket
+    SolverStats stats;
+    std::map<std::vector<int>, PortModel> portModels; // by their ports, cleared whenever the circuit changes
+
+    int noOfVolSources() { return (int) volSources.i.size(); }
+    void bucketBranches();
+    Eigen::MatrixXd admittances();
+    Eigen::MatrixXd volSourcesConnections();
+    Eigen::MatrixXd currentSources();
+    Eigen::MatrixXd voltageSources();
+    Eigen::SparseMatrix<double> sparseSystem(); // A assembled straight from the buckets, without dense G and B blocks
+    bool positiveDefinite(int unknowns) const { // A = G is SPD and big enough for conjugate gradients
+        return unknowns >= iterativeLimit &&
+               std::all_of(resistors.value.begin(), resistors.value.end(), [](double g) { return g > 0; });
+    }
+
+    void factorizeFixed();
+    template<int N> void solveFixed(); // N = n+m
+    template<size_t... N> static auto fixedSolvers(std::index_sequence<N...>) {
+        return std::array<void (Circuit::*)(), sizeof...(N)>{&Circuit::solveFixed<N + 1>...};
+    }
+    bool solveSmall(); // false if n+m is above fixedLimit
+    // Sherman-Morrison update of fixedInverse for conductance delta added between unknowns i and j, or
+    // invalidation once there were updateLimit updates or the update is ill-conditioned
+    void updateFixed(int i, int j, double delta);
+
+    // Solves with every voltage source eliminated: grounded sources fix their node voltages and floating ones
+    // merge their nodes into supernodes, so only one unknown per supernode is left. Source currents are
+    // recovered afterwards from KCL, leaves of every source tree first. Returns false if sources form a loop.
+    bool solveReduced();
+
+    // Nodes connected through resistors and voltage sources form an island. refNode grounds its own island,
+    // every other (floating) island is grounded at its lowest node, so A stays regular and block-diagonal.
+    std::vector<int> islands, islandRefs; // island of every node, reference node of every island (refNode's first)
+    std::vector<int> unknowns; // index of every node voltage in x, -1 for reference nodes
+    void findIslands();
+    std::vector<int> islandsOfUnknowns(); // island of every unknown of A
+    int nodeUnknowns() const { return noOfNodes - (int) islandRefs.size(); }
+    int unknown(int node) const { return unknowns[node]; } // index of the node voltage in x, -1 for references
+    static long long nodePair(int i, int j) { return (long long) std::min(i, j) << 32 | std::max(i, j); }
+    static void countK(std::vector<Branch> &vecB); // numbering branches that connect the same two nodes
+    void build(const std::vector<Element> &elements); // branches and meter recipes of a parsed netlist
+    bool loadCompiled(std::string_view image, std::uint64_t hash); // false if image is not a cache of this netlist
+    void saveCompiled(const std::string &cacheFile, std::uint64_t hash) const;
+    std::vector<Branch> branchesFromTxt(const std::vector<Element> &elements, bool withAmmeters);
+    // Finds how the current of every ammeter and wattmeter follows from the other currents of meterBranches:
+    // first meters in series with exactly one other branch, then meters alone in a wire (sum of the other
+    // currents at one of their nodes). The node-to-branch incidence is kept as a CSR index.
+    void placeMeters();
+    int circuitNode(int node) const; // node numbered as in "Struje kroz grane" in the numbering of branches
+    // Currents of meterBranches, with the found ammeters and wattmeters (types 6 and 9)
+    std::vector<double> currentsWithMeters();
+
+public:
+    explicit Circuit(int noOfNodes) : noOfNodes(noOfNodes) { solved = false; }
+    explicit Circuit(const std::vector<Element> &elements);
+    // With useCache the netlist is compiled once into "<fileName>.dcc" and loaded from there while its
+    // content hash still matches, skipping the parse and node merging. With statistics the parse is timed too.
+    explicit Circuit(const std::string &fileName, bool useCache = false, bool statistics = false);
+
+    void setRefNode(int rNode);
+    void setBranches(const std::vector<Branch> &vecB);
+
+    void factorize();
+    Eigen::SparseMatrix<double> systemMatrix(); // A of the full MNA system, assembled without factorizing it
+    // components are resistors and sources, numbered from 0 in the order of "Struje kroz grane"
+    int noOfComponents() const { return (int) components.size(); }
+    int getComponentType(int c) const { return branches.at(components.at(c)).getType(); }
+    double getComponentValue(int c) const { return branches.at(components.at(c)).getValue(); }
+    void setComponentValue(int c, double value);
+    Eigen::MatrixXd rightHandSide();
+    Eigen::VectorXd sourceValues(); // values of voltage and current sources, in netlist order
+    Eigen::MatrixXd sourceScenarios(const Eigen::MatrixXd &values); // each column holds sourceValues() of one scenario
+    Solutions solveScenarios(const Eigen::MatrixXd &b);
+
+    // Circuits with only resistors and current sources (or with every voltage source eliminated) and at least
+    // limit unknowns are solved by conjugate gradients with an incomplete Cholesky preconditioner, until the
+    // residual is below tolerance times the right-hand side. Each solve starts from the previous solution.
+    void setIterative(int limit, double tol) {
+        iterativeLimit = limit;
+        tolerance = tol;
+        solver.reset();
+    }
+    // Sparse LU factors in float, refined with residuals in double up to the accuracy of a double solution.
+    // A that is too ill-conditioned for that is factorized in double after all.
+    void setMixedPrecision(bool mixed) {
+        precision = mixed ? Precision::Mixed : Precision::Double;
+        solver.reset();
+    }
+    void setReducedSources(bool reduce) { // solve() eliminates voltage sources instead of adding them to A
+        reducedSources = reduce;
+        solved = false;
+    }
+    void solve();
+    std::vector<double> getBranchesCurrents();
+    std::vector<double> voltmetersVoltages(int type = 4); // type 7 for the voltage coils of wattmeters
+    Readings readings();
+    // Derivatives of every meter reading by the value of every component, from one adjoint solve per reading
+    // (A is symmetric, so with the factorization of A): dy/dp = h + lambda^T (db/dp - dA/dp x), A lambda = g,
+    // where y = g^T x + h p near the solution
+    Sensitivities sensitivities();
+    void setSensitivities(bool report) { reportSensitivities = report; } // results() include sensitivities()
+    Results results();
+    // Equivalent of the circuit at the given nodes (numbered as in "Struje kroz grane"), kept until the circuit
+    // changes. Ports have to be connected to the reference node.
+    const PortModel &portModel(const std::vector<int> &ports);
+    // reference nodes of the islands not connected to the reference node, numbered as in "Struje kroz grane"
+    std::vector<int> floatingIslands() const;
+    void printVoltmeters(std::ostream &out = std::cout);
+    void printCurrents(std::ostream &out = std::cout);
+    void printSolution(std::ostream &out = std::cout);
+    void writeSolution(std::ostream &out, ResultFormat format);
+    void setStatistics(bool on) { stats.enabled = on; } // phases are timed only from then on, off by default
+    const SolverStats &statistics(); // phase timings and counters so far, with the residual of the last solution
+};
+
+#endif //DCCALCULATOR_CIRCUIT_H
@@ -0,0 +1,131 @@
+#include "Circuit.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+
+// Compiled netlist: the header, then branches and meterBranches as BranchRecords, then meters, meterStart
+// and meterTerms as they are kept in Circuit. Everything is in native byte order, the magic number only
+// matches on machines with the same one.
+namespace {
+
+const uint32_t magic = 0x42434344; // "DCCB"
+const uint32_t version = 1;
+
+struct Header {
+    uint32_t magic, version;
+    uint64_t hash;
+    int32_t noOfNodes, noOfBranches, noOfMeterBranches, noOfMeters, noOfMeterTerms, reserved;
+};
+
+struct BranchRecord {
+    int32_t nodeI, nodeJ, branchK, type;
+    double value;
+};
+
+struct TermRecord {
+    int32_t branch, sign;
+};
+
+size_t imageSize(const Header &h) {
+    return sizeof(Header) + (h.noOfBranches + (size_t) h.noOfMeterBranches) * sizeof(BranchRecord) +
+           (2 * (size_t) h.noOfMeters + 1) * sizeof(int32_t) + h.noOfMeterTerms * sizeof(TermRecord);
+}
+
+vector<Branch> branchesFrom(const char *&p, int count) {
+    vector<Branch> vecB;
+    vecB.reserve(count);
+    for (int k(0); k < count; k++, p += sizeof(BranchRecord)) {
+        BranchRecord r;
+        memcpy(&r, p, sizeof(r));
+        vecB.emplace_back(r.nodeI, r.nodeJ, r.branchK, r.type, r.value);
+    }
+    return vecB;
+}
+
+void write(ofstream &file, const vector<Branch> &vecB) {
+    for (const Branch &b: vecB) {
+        BranchRecord r{b.getNodeI(), b.getNodeJ(), b.getBranchK(), b.getType(), b.getValue()};
+        file.write((const char *) &r, sizeof(r));
+    }
+}
+
+} // namespace
+
+bool Circuit::loadCompiled(string_view image, uint64_t hash) {
+    Header h{};
+    if (image.size() < sizeof(Header)) return false;
+    memcpy(&h, image.data(), sizeof(h));
+    if (h.magic != magic || h.version != version || h.hash != hash) return false;
+    if (h.noOfNodes < 1 || h.noOfBranches < 0 || h.noOfMeterBranches < 0 || h.noOfMeters < 0 || h.noOfMeterTerms < 0 ||
+        image.size() != imageSize(h))
+        return false;
+    const char *p = image.data() + sizeof(Header);
+    vector<Branch> vecB = branchesFrom(p, h.noOfBranches), meterB = branchesFrom(p, h.noOfMeterBranches);
+    vector<int> newMeters(h.noOfMeters), newStart(h.noOfMeters + 1);
+    vector<MeterTerm> terms(h.noOfMeterTerms);
+    memcpy(newMeters.data(), p, newMeters.size() * sizeof(int32_t));
+    p += newMeters.size() * sizeof(int32_t);
+    memcpy(newStart.data(), p, newStart.size() * sizeof(int32_t));
+    p += newStart.size() * sizeof(int32_t);
+    for (MeterTerm &t: terms) {
+        TermRecord r;
+        memcpy(&r, p, sizeof(r));
+        p += sizeof(r);
+        t = {r.branch, r.sign};
+    }
+
+    // the file may be damaged or written by someone else, so everything used as an index is checked
+    vector<int> componentTypes, meterComponentTypes;
+    int coils = 0, wattmeters = 0;
+    for (const Branch &b: vecB) {
+        if (b.getNodeI() < 1 || b.getNodeI() > h.noOfNodes || b.getNodeJ() < 1 || b.getNodeJ() > h.noOfNodes ||
+            b.getType() < 1 || b.getType() > 9)
+            return false;
+        if (b.getType() <= 3) componentTypes.push_back(b.getType());
+        if (b.getType() == 7) coils++;
+    }
+    for (const Branch &b: meterB) {
+        if (b.getNodeI() < 1 || b.getNodeJ() < 1 || b.getType() < 1 || b.getType() > 9) return false;
+        if (b.getType() <= 3) meterComponentTypes.push_back(b.getType());
+        if (b.getType() == 8 || b.getType() == 9) wattmeters++;
+    }
+    if (componentTypes != meterComponentTypes || wattmeters > coils) return false; // components are aligned
+    for (int k: newMeters)
+        if (k < 0 || k >= h.noOfMeterBranches || (meterB[k].getType() != 6 && meterB[k].getType() != 9)) return false;
+    if (newStart.front() != 0 || newStart.back() != h.noOfMeterTerms ||
+        !is_sorted(newStart.begin(), newStart.end()))
+        return false;
+    for (const MeterTerm &t: terms)
+        if (t.branch < 0 || t.branch >= h.noOfMeterBranches || (t.sign != 1 && t.sign != -1)) return false;
+
+    noOfNodes = h.noOfNodes;
+    setBranches(vecB);
+    meterBranches = move(meterB);
+    meters = move(newMeters);
+    meterStart = move(newStart);
+    meterTerms = move(terms);
+    solved = false;
+    return true;
+}
+
+void Circuit::saveCompiled(const string &cacheFile, uint64_t hash) const {
+    Header h{magic, version, hash, noOfNodes, (int32_t) branches.size(), (int32_t) meterBranches.size(),
+             (int32_t) meters.size(), (int32_t) meterTerms.size(), 0};
+    string tmp = cacheFile + ".tmp";
+    ofstream file(tmp, ios::binary);
+    file.write((const char *) &h, sizeof(h));
+    write(file, noRefBranches);
+    write(file, meterBranches);
+    file.write((const char *) meters.data(), (streamsize) (meters.size() * sizeof(int32_t)));
+    file.write((const char *) meterStart.data(), (streamsize) (meterStart.size() * sizeof(int32_t)));
+    for (const MeterTerm &t: meterTerms) {
+        TermRecord r{t.branch, t.sign};
+        file.write((const char *) &r, sizeof(r));
+    }
+    file.close();
+    // the cache is only an optimization: a failed write leaves no file behind and the next run parses again
+    if (!file || rename(tmp.c_str(), cacheFile.c_str()) != 0) remove(tmp.c_str());
+}
@@ -0,0 +1,76 @@
+#include "Circuit.h"
+#include <cmath>
+
+using namespace std;
+
+// Circuits with n+m up to fixedLimit are solved through the inverse of A, kept in fixedInverse. A is inverted
+// in a matrix of bounded size on the stack and b is multiplied in matrices of compile-time size, so solve()
+// does not touch the heap.
+void Circuit::factorizeFixed() {
+    PhaseTimer timer(stats, SolverStats::Factorization);
+    int size = n + m;
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, fixedLimit, fixedLimit> A(size, size);
+    A.setZero();
+    for (size_t k = 0; k < resistors.i.size(); k++) {
+        int i = resistors.i[k], j = resistors.j[k];
+        double g = resistors.value[k];
+        if (i >= 0) A(i, i) += g;
+        if (j >= 0) A(j, j) += g;
+        if (i >= 0 && j >= 0) {
+            A(i, j) -= g;
+            A(j, i) -= g;
+        }
+    }
+    for (int k(0); k < m; k++) { // same as volSourcesConnections()
+        int i = volSources.i[k], j = volSources.j[k], v = (volSources.value[k] > 0) ? 1 : -1;
+        if (i >= 0) A(i, n + k) = A(n + k, i) = -v;
+        if (j >= 0) A(j, n + k) = A(n + k, j) = v;
+    }
+    Eigen::Map<Eigen::MatrixXd>(fixedInverse.data(), size, size) = A.partialPivLu().inverse();
+    stats.unknowns = size;
+    stats.nonZeros = (A.array() != 0).count();
+    stats.fillIn = size * size - stats.nonZeros;
+    fixedFactorized = true;
+    fixedUpdates = 0;
+}
+
+template<int N>
+void Circuit::solveFixed() {
+    using Vector = Eigen::Matrix<double, N, 1>;
+    if (!fixedFactorized) factorizeFixed();
+    PhaseTimer timer(stats, SolverStats::Substitution);
+    Vector b = Vector::Zero();
+    for (size_t k = 0; k < currSources.i.size(); k++) {
+        if (currSources.i[k] >= 0) b(currSources.i[k]) -= currSources.value[k];
+        if (currSources.j[k] >= 0) b(currSources.j[k]) += currSources.value[k];
+    }
+    for (int k(0); k < m; k++) b(n + k) = abs(volSources.value[k]);
+    Vector x = Eigen::Map<const Eigen::Matrix<double, N, N>>(fixedInverse.data()) * b;
+    nodesVoltages.resize(noOfNodes);
+    for (int p(1); p <= noOfNodes; p++) nodesVoltages[p - 1] = unknown(p) < 0 ? 0 : x(unknown(p));
+    volSourcesCurrents.resize(m);
+    for (int k(0); k < m; k++) volSourcesCurrents[k] = x(n + k);
+}
+
+void Circuit::updateFixed(int i, int j, double delta) {
+    int size = n + m;
+    double *inverse = fixedInverse.data();
+    array<double, fixedLimit> w{}; // A^-1 u, with u = e_i - e_j; A is symmetric, so the difference of two columns
+    for (int r(0); r < size; r++)
+        w[r] = (i >= 0 ? inverse[i * size + r] : 0) - (j >= 0 ? inverse[j * size + r] : 0);
+    double d = 1 + delta * ((i >= 0 ? w[i] : 0) - (j >= 0 ? w[j] : 0)); // 1 + delta u^T A^-1 u
+    if (++fixedUpdates > updateLimit || abs(d) < 1e-12) {
+        fixedFactorized = false;
+        return;
+    }
+    for (int c(0); c < size; c++)
+        for (int r(0); r < size; r++) inverse[c * size + r] -= delta / d * w[r] * w[c];
+}
+
+bool Circuit::solveSmall() {
+    static const auto solvers = fixedSolvers(make_index_sequence<fixedLimit>());
+    n = nodeUnknowns(), m = noOfVolSources();
+    if (n + m < 1 || n + m > fixedLimit) return false;
+    (this->*solvers[n + m - 1])();
+    return true;
+}
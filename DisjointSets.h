@@ -0,0 +1,26 @@
+#ifndef DCCALCULATOR_DISJOINTSETS_H
+#define DCCALCULATOR_DISJOINTSETS_H
+
+#include <utility>
+#include <vector>
+
+class DisjointSets { // union-find over point indices, with path halving and union by size
+    std::vector<int> parent, size;
+public:
+    explicit DisjointSets(int n) : parent(n), size(n, 1) {
+        for (int k(0); k < n; k++) parent[k] = k;
+    }
+    int find(int x) {
+        while (parent[x] != x) x = parent[x] = parent[parent[x]];
+        return x;
+    }
+    void unite(int x, int y) {
+        x = find(x), y = find(y);
+        if (x == y) return;
+        if (size[x] < size[y]) std::swap(x, y);
+        parent[y] = x;
+        size[x] += size[y];
+    }
+};
+
+#endif //DCCALCULATOR_DISJOINTSETS_H
@@ -0,0 +1,36 @@
+#ifndef DCCALCULATOR_MAPPEDFILE_H
+#define DCCALCULATOR_MAPPEDFILE_H
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class MappedFile { // read-only mapping of a whole file, unmapped on destruction
+    void *data = MAP_FAILED;
+    size_t size = 0;
+public:
+    explicit MappedFile(const std::string &fileName) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open \"" + fileName + "\"");
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size = (size_t) st.st_size;
+            data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (size > 0 && data == MAP_FAILED) throw std::runtime_error("Cannot map \"" + fileName + "\"");
+        if (size > 0) madvise(data, size, MADV_SEQUENTIAL);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() {
+        if (data != MAP_FAILED) munmap(data, size);
+    }
+    std::string_view text() const { return size ? std::string_view((const char *) data, size) : std::string_view(); }
+};
+
+#endif //DCCALCULATOR_MAPPEDFILE_H
@@ -0,0 +1,266 @@
+#include "MnaSolver.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+using Eigen::SparseMatrix;
+using Eigen::Triplet;
+using namespace std;
+
+void MnaSolver::forEachBlock(const function<void(int)> &f) const {
+    int noOfBlocks = (int) blocks.size(), noOfThreads = 1;
+    if (size >= parallelLimit) noOfThreads = min(noOfBlocks, (int) max(1u, thread::hardware_concurrency()));
+    atomic<int> next(0);
+    exception_ptr error;
+    mutex errorLock;
+    auto worker = [&]() {
+        for (int k = next++; k < noOfBlocks; k = next++) {
+            try {
+                f(k);
+            } catch (...) {
+                lock_guard<mutex> guard(errorLock);
+                error = current_exception();
+            }
+        }
+    };
+    vector<thread> pool;
+    for (int t(1); t < noOfThreads; t++) pool.emplace_back(worker);
+    worker();
+    for (thread &t: pool) t.join();
+    if (error) rethrow_exception(error);
+}
+
+SparseMatrix<double> MnaSolver::submatrix(const SparseMatrix<double> &A, int k) const {
+    const vector<int> &unknowns = blockUnknowns[k];
+    vector<Triplet<double>> triplets;
+    for (int c(0); c < unknowns.size(); c++)
+        for (SparseMatrix<double>::InnerIterator it(A, unknowns[c]); it; ++it)
+            triplets.emplace_back(local[it.row()], c, it.value());
+    SparseMatrix<double> block((long) unknowns.size(), (long) unknowns.size());
+    block.setFromTriplets(triplets.begin(), triplets.end());
+    return block;
+}
+
+MatrixXd MnaSolver::factorSolve(const MatrixXd &b) const {
+    if (dense) return inverse * b;
+    if (!blocks.empty()) {
+        MatrixXd x(size, b.cols());
+        forEachBlock([&](int k) {
+            const vector<int> &unknowns = blockUnknowns[k];
+            MatrixXd bk(unknowns.size(), b.cols());
+            for (int r(0); r < unknowns.size(); r++) bk.row(r) = b.row(unknowns[r]);
+            MatrixXd xk = blocks[k]->factorSolve(bk);
+            for (int r(0); r < unknowns.size(); r++) x.row(unknowns[r]) = xk.row(r);
+        });
+        return x;
+    }
+    int iterations;
+    if (iterative) return conjugateGradient(b, MatrixXd(), iterations);
+    if (mixed) return mixedSolve(b, iterations);
+    return lu.solve(b);
+}
+
+bool MnaSolver::refine(const MatrixXd &b, MatrixXd &x, int &iterations) const {
+    double eps = numeric_limits<double>::epsilon() * sqrt((double) size) * matrixNorm;
+    x = singleLu.solve(b.cast<float>()).cast<double>();
+    for (iterations = 0;; iterations++) {
+        MatrixXd r = b - matrix * x;
+        VectorXd scale = r.cwiseAbs().colwise().maxCoeff().transpose(); // keeps r within the range of float
+        bool done = true;
+        for (long c(0); c < b.cols(); c++) {
+            if (!(scale(c) <= eps * x.col(c).lpNorm<Eigen::Infinity>())) done = false; // NaN never passes
+            if (!(scale(c) > 0 && isfinite(scale(c)))) scale(c) = 1;
+        }
+        if (done) return true;
+        if (iterations == maxRefinements) return false;
+        MatrixXd dx = singleLu.solve((r * scale.cwiseInverse().asDiagonal()).cast<float>()).cast<double>();
+        x += dx * scale.asDiagonal();
+    }
+}
+
+MatrixXd MnaSolver::mixedSolve(const MatrixXd &b, int &iterations) const {
+    MatrixXd x;
+    if (refine(b, x, iterations)) return x;
+    Eigen::SparseLU<SparseMatrix<double>> fallback(matrix); // A turned out too ill-conditioned for this b
+    if (fallback.info() != Eigen::Success) throw logic_error("Circuit matrix is singular");
+    return fallback.solve(b);
+}
+
+MatrixXd MnaSolver::conjugateGradient(const MatrixXd &b, const MatrixXd &guess, int &iterations) const {
+    bool warm = guess.rows() == size && guess.cols() == b.cols();
+    MatrixXd x(size, b.cols());
+    iterations = 0;
+    for (long c(0); c < b.cols(); c++) {
+        double limit = tolerance * b.col(c).norm();
+        VectorXd xc = warm ? VectorXd(guess.col(c)) : VectorXd::Zero(size);
+        VectorXd r = b.col(c) - matrix * xc;
+        VectorXd z = ic.solve(r), p = z, q(size);
+        double rz = r.dot(z);
+        int k = 0;
+        for (; r.norm() > limit; k++) {
+            if (k == maxIterations) throw logic_error("Conjugate gradients did not converge");
+            q.noalias() = matrix * p;
+            double alpha = rz / p.dot(q);
+            xc += alpha * p;
+            r -= alpha * q;
+            z = ic.solve(r);
+            double rzNext = r.dot(z);
+            p = z + (rzNext / rz) * p;
+            rz = rzNext;
+        }
+        x.col(c) = xc;
+        iterations = max(iterations, k);
+    }
+    return x;
+}
+
+MatrixXd MnaSolver::projected(const MatrixXd &x) const {
+    MatrixXd y(updates.size(), x.cols());
+    for (int k(0); k < updates.size(); k++) {
+        const Update &u = updates[k];
+        y.row(k) = (u.i < 0 ? MatrixXd::Zero(1, x.cols()) : MatrixXd(x.row(u.i))) -
+                   (u.j < 0 ? MatrixXd::Zero(1, x.cols()) : MatrixXd(x.row(u.j)));
+    }
+    return y;
+}
+
+MnaSolver::MnaSolver(const SparseMatrix<double> &A, Precision precision) : dense(false),
+                                                                          mixed(precision == Precision::Mixed),
+                                                                          size(A.rows()) {
+    if (mixed) singleLu.analyzePattern(A.cast<float>());
+    else lu.analyzePattern(A);
+    refactorize(A);
+}
+
+MnaSolver::MnaSolver(const SparseMatrix<double> &A, double tolerance) : dense(false), iterative(true),
+                                                                       tolerance(tolerance), size(A.rows()) {
+    ic.analyzePattern(A);
+    refactorize(A);
+}
+
+MnaSolver::MnaSolver(const SparseMatrix<double> &A, const vector<int> &block, Precision precision) : dense(false),
+                                                                                                     size(A.rows()),
+                                                                                                     local(A.rows()) {
+    for (int u(0); u < size; u++) {
+        if (block[u] >= blockUnknowns.size()) blockUnknowns.resize(block[u] + 1);
+        local[u] = (int) blockUnknowns[block[u]].size();
+        blockUnknowns[block[u]].push_back(u);
+    }
+    blockUnknowns.erase(remove_if(blockUnknowns.begin(), blockUnknowns.end(),
+                                  [](const vector<int> &unknowns) { return unknowns.empty(); }), blockUnknowns.end());
+    stable_sort(blockUnknowns.begin(), blockUnknowns.end(),
+                [](const vector<int> &a, const vector<int> &b) { return a.size() > b.size(); });
+    blocks.resize(blockUnknowns.size());
+    forEachBlock([&](int k) {
+        SparseMatrix<double> sub = submatrix(A, k);
+        if (sub.rows() <= denseBlock) blocks[k] = make_unique<MnaSolver>(MatrixXd(sub));
+        else blocks[k] = make_unique<MnaSolver>(sub, precision);
+    });
+}
+
+long MnaSolver::factorNonZeros() const {
+    if (dense) return size * size;
+    if (!blocks.empty()) {
+        long nonZeros = 0;
+        for (const unique_ptr<MnaSolver> &block: blocks) nonZeros += block->factorNonZeros();
+        return nonZeros;
+    }
+    if (iterative) return ic.matrixL().nonZeros();
+    if (mixed) return (long) (singleLu.nnzL() + singleLu.nnzU());
+    return (long) (lu.nnzL() + lu.nnzU());
+}
+
+bool MnaSolver::isMixed() const {
+    if (blocks.empty()) return mixed;
+    return any_of(blocks.begin(), blocks.end(), [](const unique_ptr<MnaSolver> &block) { return block->isMixed(); });
+}
+
+void MnaSolver::refactorize(const MatrixXd &A) {
+    inverse = A.inverse();
+    updates.clear();
+}
+
+void MnaSolver::refactorize(const SparseMatrix<double> &A) {
+    if (!blocks.empty()) {
+        forEachBlock([&](int k) {
+            SparseMatrix<double> sub = submatrix(A, k);
+            if (blocks[k]->dense) blocks[k]->refactorize(MatrixXd(sub));
+            else blocks[k]->refactorize(sub);
+        });
+        updates.clear();
+        return;
+    }
+    if (iterative) {
+        matrix = A;
+        ic.factorize(A);
+        if (ic.info() != Eigen::Success) throw logic_error("Circuit matrix is not positive definite");
+        return;
+    }
+    if (mixed) {
+        matrix = A;
+        matrixNorm = 0;
+        for (long c(0); c < size; c++) matrixNorm = max(matrixNorm, A.col(c).cwiseAbs().sum()); // A is symmetric
+        singleLu.factorize(A.cast<float>());
+        MatrixXd b = A * VectorXd::Ones(size), x;
+        int iterations;
+        if (singleLu.info() == Eigen::Success && refine(b, x, iterations)) {
+            updates.clear();
+            return;
+        }
+        mixed = false; // too ill-conditioned for float factors, or singular in float only
+        matrix.resize(0, 0);
+        lu.analyzePattern(A);
+    }
+    lu.factorize(A);
+    if (lu.info() != Eigen::Success) throw logic_error("Circuit matrix is singular");
+    updates.clear();
+}
+
+bool MnaSolver::update(int key, int i, int j, double base, double g, int maxUpdates) {
+    int k = 0;
+    while (k < updates.size() && updates[k].key != key) k++;
+    if (k == updates.size()) {
+        if (g == base) return true;
+        if (iterative) return false;
+        if (k == maxUpdates) return false;
+        updates.push_back({key, i, j, base, 0});
+        VectorXd u = VectorXd::Zero(size);
+        if (i >= 0) u(i) = 1;
+        if (j >= 0) u(j) = -1;
+        Z.conservativeResize(size, k + 1);
+        Z.col(k) = factorSolve(u);
+    }
+    updates[k].delta = g - updates[k].base;
+    if (updates[k].delta == 0) { // back to the factorized value
+        updates.erase(updates.begin() + k);
+        MatrixXd rest(size, updates.size());
+        rest << Z.leftCols(k), Z.rightCols(updates.size() - k);
+        Z = rest;
+    }
+    if (updates.empty()) return true;
+    MatrixXd D = projected(Z);
+    for (int l(0); l < updates.size(); l++) D(l, l) += 1 / updates[l].delta;
+    S.compute(D);
+    return S.rcond() > 1e-12;
+}
+
+MatrixXd MnaSolver::solve(const MatrixXd &b, const MatrixXd &guess, int &iterations) const {
+    iterations = 0;
+    if (iterative) return conjugateGradient(b, guess, iterations);
+    if (!mixed) return solve(b);
+    MatrixXd x = mixedSolve(b, iterations);
+    if (!updates.empty()) x -= Z * S.solve(projected(x));
+    return x;
+}
+
+MatrixXd MnaSolver::solve(const MatrixXd &b) const {
+    MatrixXd x = factorSolve(b);
+    if (!updates.empty()) x -= Z * S.solve(projected(x));
+    return x;
+}
@@ -0,0 +1,82 @@
+#ifndef DCCALCULATOR_MNASOLVER_H
+#define DCCALCULATOR_MNASOLVER_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <Eigen/IterativeLinearSolvers>
+
+enum class Precision {
+    Double,
+    Mixed // LU factors in float, solutions refined with residuals in double
+};
+
+class MnaSolver { // factorization of A, reused for any number of right-hand sides
+    struct Update { int key, i, j; double base, delta; }; // conductance between unknowns i and j (-1 for reference)
+    Eigen::MatrixXd inverse; // tiny systems keep the dense inverse
+    Eigen::SparseLU<Eigen::SparseMatrix<double>> lu;
+    // symmetric positive definite A (no voltage sources) can be solved by preconditioned conjugate gradients
+    Eigen::SparseMatrix<double> matrix;
+    Eigen::IncompleteCholesky<double, Eigen::Lower, Eigen::NaturalOrdering<int>> ic;
+    // mixed precision: A is factorized in float, which halves the memory traffic of factorization and
+    // substitution, and every solution is refined with residuals of the double A kept in matrix
+    Eigen::SparseLU<Eigen::SparseMatrix<float>> singleLu;
+    bool dense, iterative{}, mixed{};
+    double matrixNorm{}; // max row sum of |A|, for the stopping test of refinement
+    static const int maxRefinements = 30;
+    double tolerance{}; // of |b - A x| relative to |b|
+    static const int maxIterations = 10000;
+    long size;
+    // conductance changes since the factorization, solved through the Woodbury identity (A is symmetric):
+    // (A + U D U^T)^-1 b = x - Z (D^-1 + U^T Z)^-1 U^T x, with x = A^-1 b and Z = A^-1 U
+    std::vector<Update> updates;
+    Eigen::MatrixXd Z;
+    Eigen::PartialPivLU<Eigen::MatrixXd> S;
+
+    // independent islands of a block-diagonal A, each factorized on its own, on separate threads when A is large
+    std::vector<std::vector<int>> blockUnknowns; // unknowns of every block, largest block first
+    std::vector<int> local; // index of every unknown in its block
+    std::vector<std::unique_ptr<MnaSolver>> blocks;
+    static const long parallelLimit = 20000; // unknowns from which blocks get their own threads
+    static const int denseBlock = 32; // blocks up to this size keep the dense inverse
+
+    void forEachBlock(const std::function<void(int)> &f) const;
+    Eigen::SparseMatrix<double> submatrix(const Eigen::SparseMatrix<double> &A, int k) const; // block k of A
+    Eigen::MatrixXd factorSolve(const Eigen::MatrixXd &b) const;
+    // Refines x from the float factors until |b - A x| <= |x| |A| eps sqrt(size) for every column (in max
+    // norms, the test of LAPACK dsgesv). False if that takes more than maxRefinements steps.
+    bool refine(const Eigen::MatrixXd &b, Eigen::MatrixXd &x, int &iterations) const;
+    Eigen::MatrixXd mixedSolve(const Eigen::MatrixXd &b, int &iterations) const; // in double if refinement fails
+    Eigen::MatrixXd conjugateGradient(const Eigen::MatrixXd &b, const Eigen::MatrixXd &guess, int &iterations) const;
+    Eigen::MatrixXd projected(const Eigen::MatrixXd &x) const; // U^T x
+public:
+    explicit MnaSolver(const Eigen::MatrixXd &A) : inverse(A.inverse()), dense(true), size(A.rows()) {}
+    // With Precision::Mixed, A whose float factors cannot refine a test solution to double accuracy is
+    // factorized in double instead (for good, later refactorizations stay in double)
+    explicit MnaSolver(const Eigen::SparseMatrix<double> &A, Precision precision = Precision::Double);
+    MnaSolver(const Eigen::SparseMatrix<double> &A, double tolerance); // iterative, A has to be SPD
+    MnaSolver(const Eigen::SparseMatrix<double> &A, const std::vector<int> &block, // block of every unknown
+              Precision precision = Precision::Double);
+
+    // new values with the same sparsity pattern, the ordering found for the first matrix is kept
+    void refactorize(const Eigen::MatrixXd &A);
+    void refactorize(const Eigen::SparseMatrix<double> &A);
+
+    bool isIterative() const { return iterative; }
+    bool isMixed() const; // factors kept in float (of every non-dense block)
+    long factorNonZeros() const; // of L and U, of the incomplete Cholesky factor when iterative
+    int noOfUpdates() const { return (int) updates.size(); }
+    // Conductance "key" between unknowns i and j was base when A was factorized and is g now. Returns false
+    // when the change should rather be refactorized: more than maxUpdates changes or an ill-conditioned update.
+    // An iterative solver always refactorizes, which only recomputes its preconditioner.
+    bool update(int key, int i, int j, double base, double g, int maxUpdates);
+
+    Eigen::MatrixXd solve(const Eigen::MatrixXd &b) const;
+    // guess is where the iterative solver starts from (ignored by direct ones or if its size does not match b),
+    // iterations are those of conjugate gradients or of refinement in mixed precision
+    Eigen::MatrixXd solve(const Eigen::MatrixXd &b, const Eigen::MatrixXd &guess, int &iterations) const;
+};
+
+#endif //DCCALCULATOR_MNASOLVER_H
@@ -0,0 +1,137 @@
+#include "Netlist.h"
+#include "Chunks.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+int toInt(string_view s) {
+    int x = 0;
+    if (from_chars(s.data(), s.data() + s.size(), x).ec != errc())
+        throw logic_error("Invalid number \"" + string(s) + "\" in netlist");
+    return x;
+}
+
+double toDouble(string_view s) {
+    double x = 0;
+    if (from_chars(s.data(), s.data() + s.size(), x).ec != errc())
+        throw logic_error("Invalid number \"" + string(s) + "\" in netlist");
+    return x;
+}
+
+int elementType(string_view t) {
+    if (t == "r") return 1; // Resistor
+    if (t == "v") return 2; // Voltage source
+    if (t == "i") return 3; // Current source
+    if (t == "p") return 4; // Voltmeter
+    if (t == "370") return 5; // Ammeter
+    if (t == "p420") return 7; // Wattmeter voltage
+    if (t == "i420" || t == "420") return 8; // Wattmeter current
+    if (t == "w") return 0; // Wire
+    return -1;
+}
+
+const size_t chunkSize = 1 << 20; // bytes of netlist parsed by one thread, at least
+
+void parseLines(string_view text, vector<Element> &elements) {
+    elements.reserve(elements.size() + count(text.begin(), text.end(), '\n') + 1);
+    const int maxParts = 9; // parts[8] is the value of a voltage source, other elements use the last part
+    string_view parts[maxParts];
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == string_view::npos) end = text.size();
+        string_view line = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        int count = 0;
+        string_view last;
+        for (size_t k = 0; k < line.size();) {
+            if (line[k] == ' ' || line[k] == '\t' || line[k] == '\r') {
+                k++;
+                continue;
+            }
+            size_t start = k;
+            while (k < line.size() && line[k] != ' ' && line[k] != '\t' && line[k] != '\r') k++;
+            last = line.substr(start, k - start);
+            if (count < maxParts) parts[count] = last;
+            count++;
+        }
+        if (count == 0) continue;
+        int type = elementType(parts[0]);
+        if (type < 0) continue;
+        if (count < 6 || (type == 2 && count < 9) || (parts[0] == "420" && count < 7))
+            throw logic_error("Too few values in netlist line \"" + string(line) + "\"");
+
+        Element e{type, toInt(parts[1]), toInt(parts[2]), toInt(parts[3]), toInt(parts[4]),
+                  toDouble(type == 2 ? parts[8] : last)};
+        elements.push_back(e);
+        if (parts[0] == "420") { // dividing wattmeter into ammeter and voltmeter and a wire
+            int vX, vY, wX, wY;
+            if (e.yI == e.yJ) { // horizontal
+                vX = e.xI;
+                vY = e.yI + toInt(parts[6]);
+                wX = e.xJ;
+                wY = vY;
+            } else if (e.xI == e.xJ) { // vertical
+                vX = e.xI + toInt(parts[6]);
+                vY = e.yI;
+                wX = vX;
+                wY = e.yJ;
+            } else throw logic_error("Wattmeter should be placed vertically or horizontally");
+            elements.push_back({7, e.xI, e.yI, vX, vY, 0});
+            elements.push_back({0, vX, vY, wX, wY, 0});
+        }
+    }
+}
+
+} // namespace
+
+vector<Element> readNetlist(string_view text) {
+    vector<Element> elements;
+    int chunks = noOfChunks(text.size(), chunkSize);
+    if (chunks == 1) {
+        parseLines(text, elements);
+        return elements;
+    }
+    vector<size_t> bounds(chunks + 1, text.size()); // chunks of whole lines
+    bounds[0] = 0;
+    for (int c(1); c < chunks; c++) {
+        size_t end = text.find('\n', max(bounds[c - 1], text.size() / chunks * c));
+        bounds[c] = end == string_view::npos ? text.size() : end + 1;
+    }
+    vector<vector<Element>> parts(chunks);
+    forEachChunk(chunks, [&](int c) { parseLines(text.substr(bounds[c], bounds[c + 1] - bounds[c]), parts[c]); });
+    size_t size = 0;
+    for (const vector<Element> &part: parts) size += part.size();
+    elements.reserve(size);
+    for (const vector<Element> &part: parts) elements.insert(elements.end(), part.begin(), part.end());
+    return elements;
+}
+
+vector<Element> readNetlist(istream &in) {
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    return readNetlist(string_view(text));
+}
+
+vector<Element> readNetlistFile(const string &fileName) {
+    if (fileName == "-") return readNetlist(cin);
+    MappedFile file(fileName);
+    return readNetlist(file.text());
+}
+
+uint64_t contentHash(string_view text) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c: text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,23 @@
+#ifndef DCCALCULATOR_NETLIST_H
+#define DCCALCULATOR_NETLIST_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Element { // one element of a Falstad export, end points still given as coordinates
+    int type; // same codes as Branch::type, 0 - wire
+    int xI, yI, xJ, yJ;
+    double value;
+};
+
+// Elements of a Falstad "Export As Text" netlist. Lines of other element types are ignored and
+// every wattmeter ("420") is divided into its current coil, voltage coil and a wire.
+std::vector<Element> readNetlist(std::string_view text);
+std::vector<Element> readNetlist(std::istream &in);
+std::vector<Element> readNetlistFile(const std::string &fileName); // memory-mapped, "-" reads stdin
+std::uint64_t contentHash(std::string_view text); // FNV-1a of the netlist text, keys its compiled cache
+
+#endif //DCCALCULATOR_NETLIST_H
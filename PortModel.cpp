@@ -0,0 +1,44 @@
+#include "PortModel.h"
+#include <stdexcept>
+
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+using namespace std;
+
+namespace {
+
+VectorXd difference(long k, int a, int b) { // e_a - e_b
+    if (a < 0 || a >= k || b < -1 || b >= k) throw out_of_range("Port out of boundaries");
+    VectorXd e = VectorXd::Zero(k);
+    e(a) += 1;
+    if (b >= 0) e(b) -= 1;
+    return e;
+}
+
+} // namespace
+
+MatrixXd PortModel::conductances() const {
+    Eigen::FullPivLU<MatrixXd> lu(impedances);
+    if (!lu.isInvertible()) throw logic_error("A voltage source fixes a port, it has no finite conductance");
+    return lu.inverse();
+}
+
+double PortModel::theveninVoltage(int a, int b) const {
+    return difference(openVoltages.size(), a, b).dot(openVoltages);
+}
+
+double PortModel::theveninResistance(int a, int b) const {
+    VectorXd e = difference(openVoltages.size(), a, b);
+    return e.dot(impedances * e);
+}
+
+VectorXd PortModel::loaded(const MatrixXd &loads) const {
+    // loads draw j = -loads v, so (I + Z loads) v = openVoltages
+    long k = openVoltages.size();
+    return (MatrixXd::Identity(k, k) + impedances * loads).partialPivLu().solve(openVoltages);
+}
+
+VectorXd PortModel::loaded(int a, int b, double resistance) const {
+    VectorXd e = difference(openVoltages.size(), a, b);
+    return loaded(e * e.transpose() / resistance);
+}
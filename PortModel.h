@@ -0,0 +1,25 @@
+#ifndef DCCALCULATOR_PORTMODEL_H
+#define DCCALCULATOR_PORTMODEL_H
+
+#include <vector>
+#include <Eigen/Dense>
+
+// Equivalent of a whole circuit seen from a few of its nodes (ports), the Schur complement of everything else:
+// port voltages are v = openVoltages + impedances * j for currents j injected into the ports. Every other
+// query is solved in this k x k system instead of the circuit.
+struct PortModel {
+    std::vector<int> ports; // nodes, numbered as in "Struje kroz grane"
+    Eigen::VectorXd openVoltages; // of the ports against the reference node, with nothing attached
+    Eigen::MatrixXd impedances; // Z = (A^-1) restricted to the ports, symmetric
+
+    // Norton form: j = Y v - Y openVoltages, with Y = Z^-1; throws if a voltage source fixes a port
+    Eigen::MatrixXd conductances() const;
+    // Thevenin equivalent between ports a and b (indices into ports), b = -1 for the reference node
+    double theveninVoltage(int a, int b = -1) const;
+    double theveninResistance(int a, int b = -1) const;
+    // port voltages with loads attached, given as conductances between ports (k x k, built like G)
+    Eigen::VectorXd loaded(const Eigen::MatrixXd &loads) const;
+    Eigen::VectorXd loaded(int a, int b, double resistance) const; // a single resistor between ports a and b
+};
+
+#endif //DCCALCULATOR_PORTMODEL_H
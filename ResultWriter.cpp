@@ -0,0 +1,224 @@
+#include "ResultWriter.h"
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const uint32_t magic = 0x52434344; // "DCCR"
+const uint32_t version = 2;
+
+struct Header {
+    uint32_t magic, version;
+    int32_t noOfBranches, noOfVoltmeters, noOfAmmeters, noOfWattmeters, noOfFloatingIslands;
+    int32_t noOfSensitivities; // per reading, 0 when they are not reported
+};
+
+struct BranchRecord {
+    int32_t nodeI, nodeJ, branchK, type;
+    double current;
+};
+
+} // namespace
+
+ResultFormat resultFormat(const string &name) {
+    if (name == "text") return ResultFormat::Text;
+    if (name == "csv") return ResultFormat::Csv;
+    if (name == "jsonl") return ResultFormat::JsonLines;
+    if (name == "binary") return ResultFormat::Binary;
+    throw invalid_argument("Unknown result format \"" + name + "\" (text, csv, jsonl or binary)");
+}
+
+string resultExtension(ResultFormat format) {
+    switch (format) {
+        case ResultFormat::Csv: return ".csv";
+        case ResultFormat::JsonLines: return ".jsonl";
+        case ResultFormat::Binary: return ".bin";
+        default: return ".out";
+    }
+}
+
+void ResultWriter::number(double x) {
+    char s[32];
+    if (!isfinite(x)) { // not valid in JSON either, so written as null
+        buffer += format == ResultFormat::JsonLines ? "null" : isnan(x) ? "nan" : x > 0 ? "inf" : "-inf";
+        return;
+    }
+    buffer.append(s, to_chars(s, s + sizeof(s), x).ptr);
+}
+
+void ResultWriter::fixed3(double x) {
+    char s[32];
+    int length = snprintf(s, sizeof(s), "%.3lf", x);
+    buffer.append(s, min<size_t>(length, sizeof(s) - 1));
+}
+
+void ResultWriter::row(const char *kind, const char *name, int k, double value, const char *unit) {
+    if (format == ResultFormat::Csv) {
+        buffer += kind;
+        buffer += ',';
+        buffer += name;
+        buffer += to_string(k);
+        buffer += ',';
+        number(value);
+        buffer += ',';
+        buffer += unit;
+        buffer += '\n';
+    } else {
+        buffer += "{\"kind\":\"";
+        buffer += kind;
+        buffer += "\",\"name\":\"";
+        buffer += name;
+        buffer += to_string(k);
+        buffer += "\",\"value\":";
+        number(value);
+        buffer += ",\"unit\":\"";
+        buffer += unit;
+        buffer += "\"}\n";
+    }
+    flushIfFull();
+}
+
+void ResultWriter::sensitivities(const Results &r, const Eigen::MatrixXd &s, const char *name, int k,
+                                 const char *unit) {
+    if (s.cols() == 0) return;
+    static const char *components[] = {"R_", "E_", "Is_"}, *units[] = {"Ω", "V", "A"};
+    for (int c(0); c < s.cols(); c++) {
+        double value = s(k - 1, c);
+        int type = r.branches[c].type - 1;
+        string derivative = string("d") + name + to_string(k) + "/d" + components[type] + to_string(c + 1);
+        if (format == ResultFormat::Text) {
+            if (value == 0) continue;
+            buffer += "    " + derivative + " = ";
+            number(value);
+        } else if (format == ResultFormat::Csv) {
+            buffer += "sensitivity," + derivative + ",";
+            number(value);
+            buffer += ",";
+        } else {
+            buffer += "{\"kind\":\"sensitivity\",\"name\":\"" + derivative + "\",\"value\":";
+            number(value);
+            buffer += ",\"unit\":\"";
+        }
+        buffer += string(unit) + "/" + units[type];
+        buffer += format == ResultFormat::JsonLines ? "\"}\n" : "\n";
+        flushIfFull();
+    }
+}
+
+void ResultWriter::text(const Results &r, bool currents, bool voltmeters) {
+    if (currents) {
+        buffer += '\n';
+        if (!r.branches.empty()) buffer += "Struje kroz grane:\n";
+        for (const BranchCurrent &b: r.branches) {
+            buffer += "I_" + to_string(b.nodeI) + "_" + to_string(b.nodeJ);
+            if (b.branchK != 0) buffer += "_" + to_string(b.branchK);
+            buffer += " = ";
+            fixed3(abs(b.current * 1000) < 0.0005 ? 0.000 : b.current * 1000); // :? operator used to avoid -0
+            buffer += "mA\n";
+            flushIfFull();
+        }
+        if (r.noOfAmmeters > 0) buffer += "\nAmpermetri:\n";
+        for (int k(0); k < r.readings.ammeters.size(); k++) {
+            buffer += "Ia_" + to_string(k + 1) + " = ";
+            fixed3(r.readings.ammeters[k] * 1000);
+            buffer += "mA\n";
+            sensitivities(r, r.sensitivities.ammeters, "Ia_", k + 1, "A");
+            flushIfFull();
+        }
+        if (r.noOfWattmeters > 0) buffer += "\nVatmetri:\n";
+        for (int k(0); k < r.readings.wattmeters.size(); k++) {
+            buffer += "Pw_" + to_string(k + 1) + " = ";
+            fixed3(r.readings.wattmeters[k] * 1000);
+            buffer += "mW\n";
+            sensitivities(r, r.sensitivities.wattmeters, "Pw_", k + 1, "W");
+            flushIfFull();
+        }
+    }
+    if (voltmeters) {
+        if (!r.readings.voltmeters.empty()) buffer += "\nVoltmetri:\n";
+        for (int k(0); k < r.readings.voltmeters.size(); k++) {
+            buffer += "Uv_" + to_string(k + 1) + " = ";
+            fixed3(r.readings.voltmeters[k]);
+            buffer += "V\n";
+            sensitivities(r, r.sensitivities.voltmeters, "Uv_", k + 1, "V");
+            flushIfFull();
+        }
+    }
+    if (voltmeters && !r.floatingIslands.empty()) {
+        buffer += "\nIzolovani dijelovi mreže (potencijal mjeren prema čvoru):\n";
+        for (int node: r.floatingIslands) buffer += "N_" + to_string(node) + " = 0.000V\n";
+    }
+}
+
+void ResultWriter::binary(const Results &r) {
+    const Readings &m = r.readings;
+    Header h{magic, version, (int32_t) r.branches.size(), (int32_t) m.voltmeters.size(), (int32_t) m.ammeters.size(),
+             (int32_t) m.wattmeters.size(), (int32_t) r.floatingIslands.size(),
+             (int32_t) r.sensitivities.voltmeters.cols()};
+    raw(&h, sizeof(h));
+    for (const BranchCurrent &b: r.branches) {
+        BranchRecord record{b.nodeI, b.nodeJ, b.branchK, b.type, b.current};
+        raw(&record, sizeof(record));
+        flushIfFull();
+    }
+    for (const vector<double> *readings: {&m.voltmeters, &m.ammeters, &m.wattmeters}) {
+        raw(readings->data(), readings->size() * sizeof(double));
+        flushIfFull();
+    }
+    for (int node: r.floatingIslands) {
+        int32_t n = node;
+        raw(&n, sizeof(n));
+    }
+    const Sensitivities &s = r.sensitivities;
+    if (h.noOfSensitivities == 0) return;
+    for (const Eigen::MatrixXd *rows: {&s.voltmeters, &s.ammeters, &s.wattmeters}) { // row by row
+        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> byRows = *rows;
+        raw(byRows.data(), byRows.size() * sizeof(double));
+        flushIfFull();
+    }
+}
+
+void ResultWriter::write(const Results &r) {
+    if (format == ResultFormat::Text) return text(r, true, true);
+    if (format == ResultFormat::Binary) return binary(r);
+    if (format == ResultFormat::Csv) buffer += "kind,name,value,unit\n";
+    for (const BranchCurrent &b: r.branches) {
+        string name = "I_" + to_string(b.nodeI) + "_" + to_string(b.nodeJ);
+        if (b.branchK != 0) name += "_" + to_string(b.branchK);
+        if (format == ResultFormat::Csv) {
+            buffer += "branch," + name + ",";
+            number(b.current);
+            buffer += ",A\n";
+        } else {
+            buffer += "{\"kind\":\"branch\",\"name\":\"" + name + "\",\"nodeI\":" + to_string(b.nodeI) +
+                      ",\"nodeJ\":" + to_string(b.nodeJ) + ",\"branchK\":" + to_string(b.branchK) +
+                      ",\"type\":" + to_string(b.type) + ",\"value\":";
+            number(b.current);
+            buffer += ",\"unit\":\"A\"}\n";
+        }
+        flushIfFull();
+    }
+    for (int k(0); k < r.readings.ammeters.size(); k++) {
+        row("ammeter", "Ia_", k + 1, r.readings.ammeters[k], "A");
+        sensitivities(r, r.sensitivities.ammeters, "Ia_", k + 1, "A");
+    }
+    for (int k(0); k < r.readings.wattmeters.size(); k++) {
+        row("wattmeter", "Pw_", k + 1, r.readings.wattmeters[k], "W");
+        sensitivities(r, r.sensitivities.wattmeters, "Pw_", k + 1, "W");
+    }
+    for (int k(0); k < r.readings.voltmeters.size(); k++) {
+        row("voltmeter", "Uv_", k + 1, r.readings.voltmeters[k], "V");
+        sensitivities(r, r.sensitivities.voltmeters, "Uv_", k + 1, "V");
+    }
+    for (int node: r.floatingIslands) row("island", "N_", node, 0, "V"); // reference node of a floating island
+}
+
+void ResultWriter::flush() {
+    out.write(buffer.data(), (streamsize) buffer.size());
+    buffer.clear();
+}
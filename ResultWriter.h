@@ -0,0 +1,47 @@
+#ifndef DCCALCULATOR_RESULTWRITER_H
+#define DCCALCULATOR_RESULTWRITER_H
+
+#include <iostream>
+#include <string>
+#include "Circuit.h"
+
+enum class ResultFormat {
+    Text, // the report of printSolution: "Struje kroz grane", "Ampermetri", "Vatmetri", "Voltmetri"
+    Csv, // kind,name,value,unit with values in A, V and W
+    JsonLines, // one object per branch and meter
+    Binary // header, branch records, meter readings as doubles and floating islands, in native byte order
+};
+
+ResultFormat resultFormat(const std::string &name); // "text", "csv", "jsonl" or "binary"
+std::string resultExtension(ResultFormat format); // ".out", ".csv", ".jsonl" or ".bin"
+
+class ResultWriter { // formats results into one large buffer, handed to out in big blocks
+    std::ostream &out;
+    ResultFormat format;
+    std::string buffer;
+    static const size_t blockSize = 1 << 20;
+
+    void number(double x); // shortest text that reads back as x
+    void fixed3(double x);
+    void raw(const void *data, size_t size) { buffer.append((const char *) data, size); }
+    void flushIfFull() {
+        if (buffer.size() >= blockSize) flush();
+    }
+    void row(const char *kind, const char *name, int k, double value, const char *unit);
+    // d(reading)/d(value) of every component, after the reading name+k, skipping zeros in text
+    void sensitivities(const Results &r, const Eigen::MatrixXd &s, const char *name, int k, const char *unit);
+    void text(const Results &r, bool currents, bool voltmeters);
+    void binary(const Results &r);
+public:
+    ResultWriter(std::ostream &out, ResultFormat format) : out(out), format(format) { buffer.reserve(blockSize); }
+    ResultWriter(const ResultWriter &) = delete;
+    ResultWriter &operator=(const ResultWriter &) = delete;
+    ~ResultWriter() { flush(); }
+
+    void write(const Results &r);
+    void writeCurrents(const Results &r) { text(r, true, false); } // text of printCurrents
+    void writeVoltmeters(const Results &r) { text(r, false, true); } // text of printVoltmeters
+    void flush();
+};
+
+#endif //DCCALCULATOR_RESULTWRITER_H
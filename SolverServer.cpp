@@ -0,0 +1,204 @@
+#include "SolverServer.h"
+#include "ResultWriter.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+class Connection { // buffered reading of lines and payloads from a file descriptor
+    int in, out;
+    string buffer;
+    size_t position = 0;
+
+    bool fill() {
+        if (position > 0) {
+            buffer.erase(0, position);
+            position = 0;
+        }
+        char chunk[65536];
+        ssize_t got;
+        do got = read(in, chunk, sizeof(chunk));
+        while (got < 0 && errno == EINTR);
+        if (got <= 0) return false;
+        buffer.append(chunk, got);
+        return true;
+    }
+public:
+    Connection(int in, int out) : in(in), out(out) {}
+
+    bool readLine(string &line) {
+        size_t end;
+        while ((end = buffer.find('\n', position)) == string::npos)
+            if (!fill()) return false;
+        line.assign(buffer, position, end - position);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        position = end + 1;
+        return true;
+    }
+
+    bool readBytes(size_t size, string &bytes) {
+        while (buffer.size() - position < size)
+            if (!fill()) return false;
+        bytes.assign(buffer, position, size);
+        position += size;
+        return true;
+    }
+
+    bool reply(bool ok, const string &payload) {
+        string message = (ok ? "ok " : "error ") + to_string(payload.size()) + "\n" + payload;
+        for (size_t sent = 0; sent < message.size();) {
+            ssize_t put = write(out, message.data() + sent, message.size() - sent);
+            if (put < 0 && errno == EINTR) continue;
+            if (put <= 0) return false;
+            sent += put;
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+shared_ptr<SolverServer::Entry> SolverServer::find(const string &name) {
+    lock_guard<mutex> guard(lock);
+    auto it = circuits.find(name);
+    if (it == circuits.end()) throw out_of_range("No circuit \"" + name + "\"");
+    return it->second;
+}
+
+void SolverServer::serve(int in, int out) {
+    Connection c(in, out);
+    string line;
+    while (c.readLine(line)) {
+        istringstream words(line);
+        string command, name;
+        words >> command >> name;
+        if (command.empty()) continue;
+        if (command == "quit") {
+            c.reply(true, "");
+            return;
+        }
+        string answer;
+        try {
+            if (command == "load") {
+                size_t size = 0;
+                string text;
+                if (name.empty() || !(words >> size)) throw invalid_argument("Usage: load <name> <bytes>");
+                if (!c.readBytes(size, text)) return;
+                auto entry = make_shared<Entry>(readNetlist(string_view(text)));
+                entry->circuit.setRefNode(1);
+                entry->circuit.factorize(); // the first solve should not pay for it
+                answer = to_string(entry->circuit.noOfComponents());
+                lock_guard<mutex> guard(lock);
+                circuits[name] = entry;
+            } else if (command == "set") {
+                int component;
+                double value;
+                if (!(words >> component >> value)) throw invalid_argument("Usage: set <name> <component> <value>");
+                shared_ptr<Entry> entry = find(name);
+                lock_guard<mutex> guard(entry->lock);
+                if (component < 1 || component > entry->circuit.noOfComponents())
+                    throw out_of_range("Component " + to_string(component) + " out of boundaries (1.." +
+                                       to_string(entry->circuit.noOfComponents()) + ")");
+                entry->circuit.setComponentValue(component - 1, value); // numbered from 1 as in "Struje kroz grane"
+            } else if (command == "solve") {
+                string format = "text";
+                words >> format;
+                shared_ptr<Entry> entry = find(name);
+                ostringstream solution;
+                {
+                    lock_guard<mutex> guard(entry->lock);
+                    entry->circuit.solve();
+                    entry->circuit.writeSolution(solution, resultFormat(format));
+                }
+                answer = solution.str();
+            } else if (command == "drop") {
+                lock_guard<mutex> guard(lock);
+                if (!circuits.erase(name)) throw out_of_range("No circuit \"" + name + "\"");
+            } else
+                throw invalid_argument("Unknown command \"" + command + "\"");
+        } catch (exception &e) {
+            if (!c.reply(false, e.what())) return;
+            continue;
+        }
+        if (!c.reply(true, answer)) return;
+    }
+}
+
+void SolverServer::listen(const string &socketPath, int noOfThreads) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) throw invalid_argument("Socket path too long");
+    strcpy(address.sun_path, socketPath.c_str());
+    struct stat existing{};
+    if (lstat(socketPath.c_str(), &existing) == 0) { // only a socket left over from a previous server is removed
+        if (!S_ISSOCK(existing.st_mode)) throw runtime_error("\"" + socketPath + "\" exists and is not a socket");
+        if (unlink(socketPath.c_str()) < 0) throw runtime_error("Cannot remove \"" + socketPath + "\"");
+    }
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) throw runtime_error("Cannot create socket");
+    if (::bind(server, (sockaddr *) &address, sizeof(address)) < 0 || ::listen(server, 64) < 0) {
+        close(server);
+        throw runtime_error("Cannot listen on \"" + socketPath + "\"");
+    }
+
+    mutex queueLock;
+    condition_variable ready;
+    deque<int> clients;
+    bool stopping = false; // accept() failed for good, workers finish the queued clients
+    auto worker = [&]() {
+        for (;;) {
+            int client;
+            {
+                unique_lock<mutex> guard(queueLock);
+                ready.wait(guard, [&]() { return stopping || !clients.empty(); });
+                if (clients.empty()) return;
+                client = clients.front();
+                clients.pop_front();
+            }
+            serve(client, client);
+            close(client);
+        }
+    };
+    if (noOfThreads < 1) noOfThreads = (int) max(1u, thread::hardware_concurrency());
+    vector<thread> pool;
+    for (int t(0); t < noOfThreads; t++) pool.emplace_back(worker);
+    string error;
+    while (error.empty()) {
+        int client = accept(server, nullptr, nullptr);
+        if (client >= 0) {
+            {
+                lock_guard<mutex> guard(queueLock);
+                clients.push_back(client);
+            }
+            ready.notify_one();
+        } else if (errno == EINTR || errno == ECONNABORTED) {
+            continue; // a signal or a client that went away before it was accepted
+        } else if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+            cerr << "accept: " << strerror(errno) << endl; // out of resources until some clients finish
+            this_thread::sleep_for(chrono::milliseconds(100));
+        } else
+            error = strerror(errno);
+    }
+    {
+        lock_guard<mutex> guard(queueLock);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (thread &t: pool) t.join();
+    close(server);
+    throw runtime_error("accept: " + error);
+}
@@ -0,0 +1,35 @@
+#ifndef DCCALCULATOR_SOLVERSERVER_H
+#define DCCALCULATOR_SOLVERSERVER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Circuit.h"
+
+// Keeps named circuits parsed, factorized and solved between requests. A session is a sequence of commands,
+// one per line, and every command gets "ok <bytes>\n" or "error <bytes>\n" followed by that many bytes:
+//   load <name> <bytes>\n<netlist text>   replaces circuit <name>, answers its number of components
+//   set <name> <component> <value>       changes a resistor or source, numbered from 1 as in "Struje kroz grane"
+//   solve <name> [text|csv|jsonl|binary] answers the solution
+//   drop <name>                          forgets the circuit
+//   quit                                 ends the session
+class SolverServer {
+    struct Entry { // one circuit, used by one session at a time
+        std::mutex lock;
+        Circuit circuit;
+        explicit Entry(const std::vector<Element> &elements) : circuit(elements) {}
+    };
+    std::mutex lock; // guards circuits, not the circuits themselves
+    std::unordered_map<std::string, std::shared_ptr<Entry>> circuits;
+
+    std::shared_ptr<Entry> find(const std::string &name);
+public:
+    void serve(int in, int out); // one session over file descriptors, until "quit" or the end of input
+    // Serves every client of a Unix-domain socket on noOfThreads workers (0 - all cores). A socket left at
+    // socketPath is replaced, anything else there is kept and the server does not start. Never returns unless
+    // the socket cannot be opened or accept() fails for good, after the clients already accepted are served.
+    void listen(const std::string &socketPath, int noOfThreads = 0);
+};
+
+#endif //DCCALCULATOR_SOLVERSERVER_H
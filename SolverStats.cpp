@@ -0,0 +1,29 @@
+#include "SolverStats.h"
+#include <cmath>
+
+using namespace std;
+
+static const char *phaseNames[SolverStats::NoOfPhases] = {"parse", "cache", "merge", "reference", "assembly",
+                                                           "factorization", "substitution", "reduction",
+                                                           "sensitivities", "print"};
+
+void SolverStats::add(Phase phase, double ms) {
+    if (!timings[phase].calls) order.push_back(phase);
+    timings[phase].ms += ms;
+    timings[phase].calls++;
+}
+
+void SolverStats::printJson(ostream &out) const {
+    out << "{\"phases\": {";
+    for (int k(0); k < order.size(); k++) {
+        const Timing &timing = timings[order[k]];
+        out << (k ? ", " : "") << "\"" << phaseNames[order[k]] << "\": {\"ms\": " << timing.ms << ", \"calls\": "
+            << timing.calls << "}";
+    }
+    out << "}, \"nodes\": " << nodes << ", \"branches\": " << branches << ", \"volSources\": " << volSources << ", \"islands\": " << islands
+        << ", \"unknowns\": " << unknowns << ", \"nonZeros\": " << nonZeros << ", \"fillIn\": " << fillIn << ", \"iterations\": " << iterations
+        << ", \"singlePrecision\": " << (singlePrecision ? "true" : "false") << ", \"residual\": ";
+    if (residual < 0 || !isfinite(residual)) out << "null"; // unknown, or NaN and inf that JSON cannot hold
+    else out << residual;
+    out << "}\n";
+}
@@ -0,0 +1,45 @@
+#ifndef DCCALCULATOR_SOLVERSTATS_H
+#define DCCALCULATOR_SOLVERSTATS_H
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+struct SolverStats { // where a circuit spent its time, and how big its system was
+    enum Phase {
+        Parse, Cache, Merge, Reference, Assembly, Factorization, Substitution, Reduction, Sensitivities, Print,
+        NoOfPhases
+    };
+    struct Timing {
+        double ms;
+        int calls;
+    };
+    bool enabled{}; // phases are timed only when enabled, counters are always kept
+    Timing timings[NoOfPhases]{};
+    std::vector<Phase> order; // phases in order of their first call
+    long nodes{}, branches{}, volSources{}, islands{};
+    long unknowns{}, nonZeros{}, fillIn{}; // of the last factorized matrix, fill-in: nonzeros of L and U beyond A
+                                           // (of L beyond the lower triangle of A when iterative)
+    int iterations{}; // of the last solve by conjugate gradients, or of its refinement in mixed precision
+    bool singlePrecision{}; // the last factorization was kept in float
+    double residual = -1; // max |A x - b| of the last solution, -1 until it is known
+
+    void add(Phase phase, double ms);
+    void printJson(std::ostream &out = std::cout) const;
+};
+
+class PhaseTimer { // adds the time until it goes out of scope to one phase, if its stats are enabled
+    SolverStats &stats;
+    SolverStats::Phase phase;
+    std::chrono::steady_clock::time_point start;
+public:
+    PhaseTimer(SolverStats &stats, SolverStats::Phase phase) : stats(stats), phase(phase) {
+        if (stats.enabled) start = std::chrono::steady_clock::now();
+    }
+    ~PhaseTimer() {
+        if (!stats.enabled) return;
+        stats.add(phase, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+};
+
+#endif //DCCALCULATOR_SOLVERSTATS_H
@@ -0,0 +1,89 @@
+#include "Watcher.h"
+#include "ResultWriter.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+bool samePlace(const Element &a, const Element &b) {
+    return a.type == b.type && a.xI == b.xI && a.yI == b.yI && a.xJ == b.xJ && a.yJ == b.yJ;
+}
+
+} // namespace
+
+int Watcher::apply(const vector<Element> &next) {
+    bool sameTopology = circuit && next.size() == elements.size();
+    for (int k(0); sameTopology && k < next.size(); k++) {
+        const Element &e = next[k];
+        bool component = e.type >= 1 && e.type <= 3; // numbered like Circuit components, in netlist order
+        if (!samePlace(e, elements[k]) || (!component && e.value != elements[k].value)) sameTopology = false;
+    }
+    vector<pair<int, double>> changes; // component, new value; only worth collecting when the topology holds
+    for (int k(0), c(0); sameTopology && k < next.size(); k++) {
+        const Element &e = next[k];
+        if (e.type < 1 || e.type > 3) continue;
+        if (e.value != elements[k].value) changes.emplace_back(c, e.value);
+        c++;
+    }
+    elements.clear(); // until the new version is solved
+    if (!sameTopology) {
+        circuit = make_unique<Circuit>(next);
+        circuit->setRefNode(1);
+    }
+    for (const pair<int, double> &change: changes) circuit->setComponentValue(change.first, change.second);
+    circuit->solve();
+    elements = next;
+    return sameTopology ? (int) changes.size() : -1;
+}
+
+bool Watcher::reload() {
+    auto start = chrono::steady_clock::now();
+    try {
+        int changes = apply(readNetlistFile(fileName));
+        circuit->writeSolution(out, format);
+        out.flush();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cerr << fileName << ": " << (changes < 0 ? "nova mreža" : "promijenjenih vrijednosti: " + to_string(changes))
+             << " (" << fixed3(ms) << " ms)" << endl;
+        return true;
+    } catch (exception &e) {
+        circuit.reset();
+        elements.clear();
+        cerr << fileName << ": " << e.what() << endl;
+        return false;
+    }
+}
+
+void Watcher::run() {
+    size_t slash = fileName.rfind('/');
+    string directory = slash == string::npos ? "." : slash == 0 ? "/" : fileName.substr(0, slash);
+    string name = slash == string::npos ? fileName : fileName.substr(slash + 1);
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) throw runtime_error(string("inotify: ") + strerror(errno));
+    if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        string error = strerror(errno);
+        close(fd);
+        throw runtime_error("Cannot watch \"" + directory + "\": " + error);
+    }
+    reload();
+    alignas(inotify_event) char events[65536];
+    while (true) {
+        ssize_t got = read(fd, events, sizeof(events));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        bool saved = false; // a save may come as several events, all of them are read at once
+        for (char *p = events; p < events + got;) {
+            auto *event = (inotify_event *) p;
+            if (event->len > 0 && name == event->name) saved = true;
+            p += sizeof(inotify_event) + event->len;
+        }
+        if (saved) reload();
+    }
+    close(fd);
+}
@@ -0,0 +1,35 @@
+#ifndef DCCALCULATOR_WATCHER_H
+#define DCCALCULATOR_WATCHER_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Circuit.h"
+
+enum class ResultFormat; // ResultWriter.h
+
+// Solves a netlist again every time it is saved. Each version is diffed against the last one that was solved:
+// when only values of resistors and sources changed, they go through Circuit::setComponentValue, which keeps
+// the node numbering and the factorization (see MnaSolver::update), any other change builds the circuit anew.
+class Watcher {
+    std::string fileName;
+    std::ostream &out;
+    ResultFormat format;
+    std::vector<Element> elements; // of the circuit, empty until a version could be solved
+    std::unique_ptr<Circuit> circuit;
+
+    int apply(const std::vector<Element> &next); // changed values, -1 if the circuit had to be built anew
+public:
+    Watcher(std::string fileName, std::ostream &out, ResultFormat format) : fileName(std::move(fileName)),
+                                                                            out(out), format(format) {}
+
+    // Reads, solves and writes the netlist, reporting the kind of change and the time it took on stderr.
+    // Returns false if this version cannot be solved; the next one is then built anew.
+    bool reload();
+    // Watches the directory of the netlist with inotify (editors often replace a file instead of writing it)
+    // and reloads on every save. Never returns unless the directory cannot be watched.
+    void run();
+};
+
+#endif //DCCALCULATOR_WATCHER_H
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Circuit.h"
+#include "Netlist.h"
+
+using namespace std;
+
+// Synthetic circuits, built as netlist elements on a grid of points (64 apart, as Falstad places them).
+// Every circuit has one voltage source from the ground rail at y = -64 and a few meters.
+namespace {
+
+const int step = 64;
+
+void resistor(vector<Element> &e, int xI, int yI, int xJ, int yJ, double r) {
+    e.push_back({1, xI * step, yI * step, xJ * step, yJ * step, r});
+}
+
+void supply(vector<Element> &e, int x, int y, double v) {
+    e.push_back({2, x * step, -step, x * step, y * step, v});
+}
+
+void rail(vector<Element> &e, int width) { // wires along the ground rail
+    for (int x(0); x < width; x++) e.push_back({0, x * step, -step, (x + 1) * step, -step, 0});
+}
+
+vector<Element> ladder(int n) { // n series resistors, each node shunted to the ground rail
+    vector<Element> e;
+    supply(e, 0, 0, 10);
+    rail(e, n + 1);
+    for (int k(0); k < n; k++) {
+        resistor(e, k, 0, k + 1, 0, 100 + k % 7);
+        resistor(e, k + 1, 0, k + 1, -1, 1000 + k % 13);
+    }
+    e.push_back({4, 0, 0, n * step, 0, 0}); // voltmeter over the ladder
+    return e;
+}
+
+vector<Element> grid(int w, int h, int layers) { // resistive w x h grid, layers stacked side by side
+    vector<Element> e;
+    supply(e, 0, 0, 10);
+    for (int l(0); l < layers; l++) {
+        int x0 = l * (w + 1);
+        for (int y(0); y < h; y++) {
+            for (int x(0); x < w; x++) {
+                if (x + 1 < w) resistor(e, x0 + x, y, x0 + x + 1, y, 10 + (x * 7 + y * 3) % 90);
+                if (y + 1 < h) resistor(e, x0 + x, y, x0 + x, y + 1, 10 + (x * 5 + y * 11) % 90);
+                if (l + 1 < layers) resistor(e, x0 + x, y, x0 + w + 1 + x, y, 50);
+            }
+        }
+    }
+    int xLast = (layers - 1) * (w + 1) + w - 1;
+    resistor(e, xLast, h - 1, xLast, -1, 1); // back to the ground rail
+    e.push_back({5, xLast * step, -step, 0, -step, 0}); // ammeter in the ground rail
+    e.push_back({4, 0, 0, xLast * step, (h - 1) * step, 0});
+    return e;
+}
+
+vector<Element> star(int n) { // n spokes into one hub, each with a source, an ammeter and a voltmeter
+    vector<Element> e;
+    int hubY = 4;
+    rail(e, n);
+    for (int k(0); k < n; k++) {
+        if (k % 2 == 0) supply(e, k, 0, 1 + k % 5);
+        else e.push_back({3, k * step, -step, k * step, 0, 0.001 * (1 + k % 3)});
+        e.push_back({5, k * step, 0, k * step, step, 0});
+        resistor(e, k, 1, n / 2, hubY, 100 + k % 17);
+        e.push_back({4, k * step, step, 0, -step, 0});
+    }
+    resistor(e, n / 2, hubY, n / 2, -1, 10);
+    return e;
+}
+
+string falstadText(const vector<Element> &elements) {
+    ostringstream out;
+    for (const Element &e: elements) {
+        string points = to_string(e.xI) + " " + to_string(e.yI) + " " + to_string(e.xJ) + " " + to_string(e.yJ);
+        switch (e.type) {
+            case 0: out << "w " << points << " 0\n"; break;
+            case 1: out << "r " << points << " 0 " << e.value << "\n"; break;
+            case 2: out << "v " << points << " 0 0 40 " << e.value << " 0 0 0.5\n"; break;
+            case 3: out << "i " << points << " 0 " << e.value << "\n"; break;
+            case 4: out << "p " << points << " 1 0 0\n"; break;
+            case 5: out << "370 " << points << " 1 0\n"; break;
+        }
+    }
+    return out.str();
+}
+
+double milliseconds(const function<void()> &phase) {
+    auto start = chrono::steady_clock::now();
+    phase();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void run(const string &family, const vector<Element> &generated) {
+    string text = falstadText(generated);
+    vector<Element> elements;
+    double parse = milliseconds([&]() { elements = readNetlist(string_view(text)); });
+    unique_ptr<Circuit> cir;
+    double merge = milliseconds([&]() { cir = make_unique<Circuit>(elements); });
+    cir->setRefNode(1);
+    long nonZeros = 0;
+    double assembly = milliseconds([&]() { nonZeros = cir->systemMatrix().nonZeros(); });
+    double solve = milliseconds([&]() { cir->solve(); });
+    ostringstream report;
+    double print = milliseconds([&]() { cir->printSolution(report); });
+    cout << left << setw(8) << family << right << setw(10) << elements.size() << setw(10) << nonZeros << fixed
+         << setprecision(2) << setw(12) << parse << setw(12) << merge << setw(12) << assembly << setw(12) << solve
+         << setw(12) << print << endl;
+}
+
+} // namespace
+
+// DCCalculatorBenchmark [max elements]: times parsing, node merging, assembly, solving and printing
+// of every circuit family at doubling sizes.
+int main(int argc, char *argv[]) {
+    long maxElements = argc > 1 ? atol(argv[1]) : 50000;
+    cout << left << setw(8) << "circuit" << right << setw(10) << "elements" << setw(10) << "nonzeros" << setw(12)
+         << "parse ms" << setw(12) << "merge ms" << setw(12) << "assemble ms" << setw(12) << "solve ms"
+         << setw(12) << "print ms" << endl;
+    try {
+        for (int n = 256; 2L * n <= maxElements; n *= 2) run("ladder", ladder(n));
+        for (int w = 16; 2L * w * w <= maxElements; w *= 2) run("grid2d", grid(w, w, 1));
+        for (int w = 4; 3L * w * w * w <= maxElements; w *= 2) run("grid3d", grid(w, w, w));
+        for (int n = 64; 4L * n <= maxElements; n *= 2) run("star", star(n));
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,57 +1,22 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <Eigen/Dense>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+#include <csignal>
+#include <unistd.h>
+#include "Circuit.h"
+#include "Chunks.h"
+#include "Analysis.h"
+#include "ResultWriter.h"
+#include "SolverServer.h"
+#include "Watcher.h"
 
-using Eigen::MatrixXd;
 using namespace std;
 
-vector<string> readFile(const string &fileName) {
-    vector<string> lines;
-    fstream file(fileName);
-    string line;
-    while (getline(file, line))
-        lines.push_back(line);
-    file.close();
-    return lines;
-}
-
-vector<string> split(const string &s, char delim) {
-    stringstream ss(s);
-    string item;
-    vector<string> elems;
-    while (getline(ss, item, delim))
-        elems.push_back(item);
-    return elems;
-}
-
-class Branch {
-    int nodeI, nodeJ, branchK, type;
-    // type = 1 for R:resistor, 2 - E:volSource, 3 - Is:currSource, 4 - Uv:voltmeter, 5 - Ia:ammeter,
-    // 6 - calculated ammeter, 7 - Wv: voltage of wattmeter, 8 - Wa: current of wattmeter, 9 - calculated Wa
-    double value;
-public:
-    Branch(int nodeI, int nodeJ, int branchK, int type, double value) : nodeI(nodeI), nodeJ(nodeJ), branchK(branchK),
-                                                                        type(type), value(value) {}
-    int getNodeI() const { return nodeI; }
-    int getNodeJ() const { return nodeJ; }
-    int getBranchK() const { return branchK; }
-    int getType() const { return type; }
-    double getValue() const { return value; }
-
-    void setNodeI(int nI) { Branch::nodeI = nI; }
-    void setNodeJ(int nJ) { Branch::nodeJ = nJ; }
-    void setBranchK(int bK) { Branch::branchK = bK; }
-    void setType(int t) { Branch::type = t; }
-    void setValue(double v) { Branch::value = v; }
-};
-
-ostream &operator<<(ostream &Str, Branch const &b) {
-    Str << to_string(b.getType()) << " " << to_string(b.getNodeI()) << ","
-        << to_string(b.getNodeJ()) << " "<< to_string(b.getValue());
-    return Str;
-}
-
 void appendToFile(const string& fileName, Branch b) {
     ofstream file(fileName, ios::app);
     int t = b.getType(), i = b.getNodeI(), j = b.getNodeJ();
@@ -65,417 +30,6 @@ void appendToFile(const string& fileName, Branch b) {
     file.close();
 }
 
-class Circuit {
-    int noOfNodes{}, refNode{}, n{}, m{};
-    bool solved;
-    vector<double> nodesVoltages, volSourcesCurrents;
-    vector<Branch> branches, noRefBranches;
-
-    int noOfVolSources() {
-        int i = 0;
-        for (Branch b: branches) {
-            if (b.getType() == 2) i++;
-        }
-        return i;
-    }
-    MatrixXd admittances() {
-        MatrixXd G = MatrixXd::Zero(n, n);
-        for (Branch b: branches) {
-            if (b.getType() != 1) continue;
-            int i = b.getNodeI(), j = b.getNodeJ();
-            j = (j < refNode) ? j : j - 1;
-            i = (i < refNode) ? i : i - 1;
-            double v = b.getValue();
-            if (i == 0) {
-                G(j - 1, j - 1) += 1 / v;
-                continue;
-            }
-            if (j == 0) {
-                G(i - 1, i - 1) += 1 / v;
-                continue;
-            }
-            G(i - 1, j - 1) -= 1 / v;
-            G(j - 1, i - 1) -= 1 / v;
-            G(i - 1, i - 1) += 1 / v;
-            G(j - 1, j - 1) += 1 / v;
-        }
-        return G;
-    }
-    MatrixXd volSourcesConnections() {
-        MatrixXd B = MatrixXd::Zero(n, m);
-        int k = 0;
-        for (Branch b: branches) {
-            if (b.getType() != 2) continue;
-            int i = b.getNodeI(), j = b.getNodeJ(), v = -1;
-            j = (j < refNode) ? j : j - 1;
-            i = (i < refNode) ? i : i - 1;
-            if (b.getValue() > 0) v = 1;
-            if (i != 0) B(i - 1, k) = -v;
-            if (j != 0) B(j - 1, k) = v;
-            k++;
-        }
-        return B;
-    }
-    MatrixXd currentSources() {
-        MatrixXd I = MatrixXd::Zero(n, 1);
-        for (Branch b: branches) {
-            if (b.getType() != 3) continue;
-            int i = b.getNodeI(), j = b.getNodeJ();
-            j = (j < refNode) ? j : j - 1;
-            i = (i < refNode) ? i : i - 1;
-            double v = b.getValue();
-            if (i != 0) I(i - 1, 0) -= v;
-            if (j != 0) I(j - 1, 0) += v;
-        }
-        return I;
-    }
-    MatrixXd voltageSources() {
-        MatrixXd e = MatrixXd::Zero(m, 1);
-        int k = 0;
-        for (Branch b: branches) {
-            if (b.getType() == 2) {
-                e(k, 0) = abs(b.getValue());
-                k++;
-            }
-        }
-        return e;
-    }
-
-    static void countK(vector<Branch> &vecB) {
-        for (int x(0); x < vecB.size(); x++) {
-            int nodeIx = vecB[x].getNodeI(), nodeJx = vecB[x].getNodeJ();
-            int k = 1;
-            bool a = false;
-            for (int y(x + 1); y < vecB.size(); y++) {
-                int nodeIy = vecB[y].getNodeI(), nodeJy = vecB[y].getNodeJ();
-                if ((nodeIx == nodeIy && nodeJx == nodeJy || nodeIx == nodeJy && nodeJx == nodeIy) &&
-                    vecB[y].getBranchK() == 0) {
-                    vecB[y].setBranchK(++k);
-                    a = true;
-                }
-            }
-            if (a) vecB[x].setBranchK(1);
-        }
-    }
-    vector<Branch> branchesFromTxt(const string& fileName, bool withAmmeters) {
-        vector<string> lines = readFile(fileName), types, values, is, js;
-        vector<Branch> vecB;
-        int num = 1;
-
-        // filling vectors "types", "values", "is" and "js"
-        for (int k(0); k < lines.size(); k++) {
-            vector<string> parts = split(lines[k], ' ');
-            if (lines[k].empty() || (parts[0] != "r" && parts[0] != "v" && parts[0] != "i" &&
-                                     parts[0] != "w" && parts[0] != "p" && parts[0] != "370" &&
-                                     parts[0] != "420" && parts[0] != "p420" && parts[0] != "i420"))
-                continue;
-            if (parts[0] == "420") { // dividing wattmeter into ammeter and voltmeter and a wire
-                int vX, vY, wX, wY;
-                if (parts[2] == parts[4]) { // horizontal
-                    vX = stoi(parts[1]);
-                    vY = stoi(parts[2]) + stoi(parts[6]);
-                    wX = stoi(parts[3]);
-                    wY = vY;
-                } else if (parts[1] == parts[3]) {  // vertical
-                    vX = stoi(parts[1]) + stoi(parts[6]);
-                    vY = stoi(parts[2]);
-                    wX = vX;
-                    wY = stoi(parts[4]);
-                } else throw logic_error("Wattmeter should be placed vertically or horizontally");
-                string vMeter =
-                        "p420 " + parts[1] + " " + parts[2] + " " + to_string(vX) + " " + to_string(vY) + " 1 0 0";
-                string wire =
-                        "w " + to_string(vX) + " " + to_string(vY) + " " + to_string(wX) + " " + to_string(wY) + " 0";
-                lines.insert(lines.begin() + k + 1, wire);
-                lines.insert(lines.begin() + k + 1, vMeter);
-                types.emplace_back("i420");
-                goto skip;
-            }
-            types.push_back(parts[0]);
-            skip:
-            is.push_back(parts[1] + "," + parts[2]);
-            js.push_back(parts[3] + "," + parts[4]);
-            string value = (parts[0] == "v") ? parts[8] : parts[parts.size() - 1];
-            values.push_back(value);
-        }
-
-        if (types.empty()) throw logic_error("Prazan krug");
-
-        string ammeter = "370", wattmeter = "i420";
-        if (withAmmeters) {
-            ammeter = "skip";
-            wattmeter = "skip";
-        }
-
-        // making one point for same potential
-        for (int k(0); k < types.size(); k++) {
-            if (types[k] == "w" || types[k] == ammeter || types[k] == wattmeter) {
-                string wireI = is[k], wireJ = js[k];
-                for (int l(0); l < types.size(); l++) {
-                    if (is[l] == wireI) is[l] = wireJ;
-                    if (js[l] == wireI) js[l] = wireJ;
-                }
-            }
-        }
-        if (withAmmeters) {
-            ammeter = "p";
-            wattmeter = "p420";
-        }
-        // erasing wires
-        for (int k(0); k < types.size(); k++) {
-            if (types[k] == "w" || types[k] == ammeter || types[k] == wattmeter) {
-                types.erase(types.begin() + k);
-                is.erase(is.begin() + k);
-                js.erase(js.begin() + k);
-                values.erase(values.begin() + k);
-                k--;
-            }
-        }
-        // replacing positions with numbers beginning from 1
-        for (int k(0); k < types.size(); k++) {
-            string compI = is[k], compJ = js[k];
-            if (compI.find(',') != string::npos) {
-                for (int l(0); l < types.size(); l++) {
-                    if (is[l] == compI) is[l] = to_string(num);
-                    if (js[l] == compI) js[l] = to_string(num);
-                }
-                num++;
-            }
-            if (compJ.find(',') != string::npos) {
-                for (int l(0); l < types.size(); l++) {
-                    if (is[l] == compJ) is[l] = to_string(num);
-                    if (js[l] == compJ) js[l] = to_string(num);
-                }
-                num++;
-            }
-        }
-        for (int k(0); k < types.size(); k++) {
-            int type, i, j;
-            double value;
-            if (types[k] == "r") type = 1; // Resistor
-            else if (types[k] == "v") type = 2; // Voltage source
-            else if (types[k] == "i") type = 3; // Current source
-            else if (types[k] == "p") type = 4; // Voltmeter
-            else if (types[k] == "370") type = 5; // Ammeter
-            else if (types[k] == "p420") type = 7; // Wattmeter voltage
-            else if (types[k] == "i420") type = 8; // Wattmeter current
-
-            i = stoi(is[k]);
-            j = stoi(js[k]);
-            value = stod(values[k]);
-            Branch branch(i, j, 0, type, value);
-            vecB.push_back(branch);
-        }
-        noOfNodes = num - 1;
-        countK(vecB);
-        return vecB;
-    }
-
-public:
-    explicit Circuit(int noOfNodes) : noOfNodes(noOfNodes) { solved = false; }
-    explicit Circuit(const string &fileName) {
-        vector<Branch> vecB = branchesFromTxt((fileName), false);
-        setBranches(vecB);
-        solved = false;
-    }
-
-    void setRefNode(int rNode) {
-        if (rNode < 1 || rNode > noOfNodes) throw out_of_range("Reference node out of boundaries");
-        Circuit::refNode = rNode;
-        for (Branch branch: branches) {
-            if (branch.getNodeI() == rNode) {
-                branch.setNodeI(0);
-            } else if (branch.getNodeJ() == rNode) {
-                branch.setNodeJ(branch.getNodeI());
-                branch.setNodeI(0);
-                if (branch.getType() != 1) branch.setValue(-branch.getValue());
-            }
-        }
-        solved = false;
-    }
-    void setBranches(const vector<Branch> &vecB) {
-        Circuit::branches = vecB;
-        noRefBranches = vecB;
-    }
-
-    void solve() {
-        n = noOfNodes - 1, m = noOfVolSources();
-        MatrixXd G(n, n), B(n, m), D = MatrixXd::Zero(m, m), A(n+m, n+m), i(n, 1), e(m, 1), b(n+m, 1), x;
-        G = admittances();
-        B = volSourcesConnections();
-        A << G,             B,
-             B.transpose(), D;
-        i = currentSources();
-        e = voltageSources();
-        b << i, e;
-
-        x = A.inverse() * b;
-        MatrixXd vn(noOfNodes, 1), iv = x.block(n, 0, m, 1);
-        vn << x.block(0, 0, refNode-1, 1), 0, x.block(refNode-1, 0, noOfNodes-refNode, 1); // inserting 0 at refNode index
-        vector<double> vecVn(vn.data(), vn.data() + vn.size());
-        vector<double> vecIv(iv.data(), iv.data() + iv.size());
-        nodesVoltages = vecVn;
-        volSourcesCurrents = vecIv;
-        solved = true;
-    }
-    vector<double> getBranchesCurrents() {
-        if (!solved) throw logic_error("Circuit is not solved yet");
-        vector<double> currents;
-        int vx = 0;
-        for (Branch b: noRefBranches) {
-            if (b.getType() == 3)
-                currents.push_back(b.getValue());
-            else if (b.getType() == 2) {
-                if (b.getValue() > 0) currents.push_back(-volSourcesCurrents[vx++]);
-                else currents.push_back(volSourcesCurrents[vx++]);
-            } else if (b.getType() == 1) {
-                double vi = nodesVoltages[b.getNodeI() - 1], vj = nodesVoltages[b.getNodeJ() - 1];
-                currents.push_back((vi - vj) / b.getValue());
-            }
-        }
-        return currents;
-    }
-    void printVoltmeters() {
-        if (!solved) throw logic_error("Circuit is not solved yet");
-        vector<double> voltmeters;
-        for (Branch b: noRefBranches) {
-            if (b.getType() == 4) {
-                int vi = b.getNodeI(), vj = b.getNodeJ();
-                double voltage = nodesVoltages[vi - 1] - nodesVoltages[vj - 1];
-                voltmeters.push_back(voltage);
-            }
-        }
-        if (!voltmeters.empty()) cout << "\nVoltmetri:\n";
-        for (int k(0); k < voltmeters.size(); k++) {
-            cout << "Uv_" << k + 1;
-            printf(" = %.3lfV\n", voltmeters[k]);
-        }
-    }
-    void printCurrents() {
-        if (!solved) throw logic_error("Circuit is not solved yet");
-        vector<Branch> newBranches = branchesFromTxt("falstad.txt", true);
-        vector<double> currents = getBranchesCurrents();
-        bool hasAmmeters = false;
-        for (int k(0); k < newBranches.size(); k++) {
-            if (newBranches[k].getType() == 5 || newBranches[k].getType() == 8)
-                currents.insert(currents.begin() + k, 0);
-        }
-        cout << endl;
-        int connections, index, sign, ki, kj, li, lj;
-        for (int k(0); k < newBranches.size(); k++) { // Ammeters in series with other components
-            ki = newBranches[k].getNodeI();
-            kj = newBranches[k].getNodeJ();
-            if (newBranches[k].getType() == 5 || newBranches[k].getType() == 8) {
-                if (newBranches[k].getType() == 5) hasAmmeters = true;
-                sign = 1;
-                connections = 0;
-                for (int l(0); l < newBranches.size(); l++) {
-                    li = newBranches[l].getNodeI();
-                    lj = newBranches[l].getNodeJ();
-                    if (k != l && (li == ki || lj == ki)) {
-                        if (li == ki) sign = -1;
-                        connections++;
-                        index = l;
-                    }
-                }
-                if (connections == 1) {
-                    currents[k] = sign * currents[index];
-                    newBranches[k].setType(newBranches[k].getType() + 1);
-                    continue;
-                }
-                sign = 1;
-                connections = 0;
-                for (int l(0); l < newBranches.size(); l++) {
-                    li = newBranches[l].getNodeI();
-                    lj = newBranches[l].getNodeJ();
-                    if (k != l && (li == kj || lj == kj)) {
-                        if (lj == kj) sign = -1;
-                        connections++;
-                        index = l;
-                    }
-                }
-                if (connections == 1) {
-                    currents[k] = sign * currents[index];
-                    newBranches[k].setType(newBranches[k].getType() + 1);
-                    continue;
-                }
-            }
-        }
-        double current;
-        for (int k(0); k < newBranches.size(); k++) { // Ammeters alone in a wire
-            ki = newBranches[k].getNodeI();
-            kj = newBranches[k].getNodeJ();
-            if (newBranches[k].getType() == 5 || newBranches[k].getType() == 8) {
-                current = 0;
-                for (int l(0); l < newBranches.size(); l++) {
-                    li = newBranches[l].getNodeI();
-                    lj = newBranches[l].getNodeJ();
-                    if (k != l && (li == ki || lj == ki)) {
-                        if (newBranches[l].getType() == 5 || newBranches[l].getType() == 8) goto nodeJ;
-                        if (li == ki) current -= currents[l];
-                        else current += currents[l];
-                    }
-                }
-                currents[k] = current;
-                newBranches[k].setType(newBranches[k].getType() + 1);
-                continue;
-                nodeJ:
-                current = 0;
-                for (int l(0); l < newBranches.size(); l++) {
-                    li = newBranches[l].getNodeI();
-                    lj = newBranches[l].getNodeJ();
-                    if (k != l && (li == kj || lj == kj)) {
-                        if (newBranches[l].getType() == 5 || newBranches[l].getType() == 8) goto next;
-                        if (lj == kj) current += currents[l];
-                        else current -= currents[l];
-                    }
-                }
-                currents[k] = current;
-                newBranches[k].setType(newBranches[k].getType() + 1);
-                next:;
-            }
-        }
-
-        if (!currents.empty()) cout << "Struje kroz grane:\n";
-        for (int k(0); k < currents.size(); k++) { // printing branches' currents
-            if (newBranches[k].getType() > 3) continue;
-            cout << "I_" << newBranches[k].getNodeI() << "_" << newBranches[k].getNodeJ();
-            if (newBranches[k].getBranchK() != 0) cout << "_" << newBranches[k].getBranchK();
-            printf(" = %.3lfmA\n", abs(currents[k] * 1000) < 0.0005 ? 0.000 : currents[k] * 1000); // :? operator used to avoid -0
-        }
-
-        if (hasAmmeters) cout << "\nAmpermetri:\n";
-        int i = 1;
-        for (int k(0); k < currents.size(); k++) { // printing ammeters' currents
-            if (newBranches[k].getType() == 6) {
-                cout << "Ia_" << i++;
-                printf(" = %.3lfmA\n", currents[k] * 1000);
-            }
-        }
-        vector<double> wattmetersVoltages;
-        for (Branch b: noRefBranches) {
-            if (b.getType() == 7) {
-                int vi = b.getNodeI(), vj = b.getNodeJ();
-                double voltage = nodesVoltages[vi - 1] - nodesVoltages[vj - 1];
-                wattmetersVoltages.push_back(voltage);
-            }
-        }
-        if (!wattmetersVoltages.empty()) cout << "\nVatmetri:\n";
-        i = 1;
-        for (int k(0); k < currents.size(); k++) { // printing wattmeters' powers
-            if (newBranches[k].getType() == 9) {
-                cout << "Pw_" << i++;
-                printf(" = %.3lfmW\n", currents[k] * wattmetersVoltages[i - 2] * 1000);
-            }
-        }
-    }
-    void printSolution() {
-        if (!solved) throw logic_error("Circuit is not solved yet");
-        printCurrents();
-        printVoltmeters();
-    }
-};
-
 void program() {
     int choice;
     cout << "\n--------------------------------------------------------------\n"
@@ -581,7 +135,242 @@ void program() {
     cir.printSolution();
 }
 
-int main() {
+// Solves every netlist on a pool of worker threads. Directories are expanded into their *.txt files and
+// each solution goes to "<netlist>.out" (.csv, .jsonl or .bin for the other formats, in outDir if given).
+// Errors are reported per netlist.
+int batch(const vector<string> &paths, const string &outDir, int noOfThreads, bool useCache,
+          ResultFormat format) {
+    namespace fs = std::filesystem;
+    vector<fs::path> files;
+    for (const string &p: paths) {
+        if (!fs::is_directory(p)) {
+            files.emplace_back(p);
+            continue;
+        }
+        vector<fs::path> dir;
+        for (const fs::directory_entry &entry: fs::directory_iterator(p))
+            if (entry.is_regular_file() && entry.path().extension() == ".txt") dir.push_back(entry.path());
+        sort(dir.begin(), dir.end());
+        files.insert(files.end(), dir.begin(), dir.end());
+    }
+    if (!outDir.empty()) fs::create_directories(outDir);
+
+    vector<string> errors(files.size());
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t k = next++; k < files.size(); k = next++) {
+            fs::path out = outDir.empty() ? files[k] : fs::path(outDir) / files[k].filename();
+            out += resultExtension(format);
+            try {
+                Circuit cir(files[k].string(), useCache);
+                cir.setRefNode(1);
+                cir.solve();
+                ofstream file(out, ios::binary);
+                cir.writeSolution(file, format);
+                file.flush();
+                if (!file) throw runtime_error("Cannot write \"" + out.string() + "\"");
+            } catch (exception &e) {
+                errors[k] = e.what();
+            }
+        }
+    };
+    if (noOfThreads < 1) noOfThreads = (int) max(1u, thread::hardware_concurrency());
+    noOfThreads = (int) min<size_t>(noOfThreads, max<size_t>(files.size(), 1));
+    vector<thread> pool;
+    for (int t(1); t < noOfThreads; t++) pool.emplace_back(worker);
+    worker();
+    for (thread &t: pool) t.join();
+
+    int failed = 0;
+    for (size_t k = 0; k < files.size(); k++) {
+        if (errors[k].empty()) continue;
+        cerr << files[k].string() << ": " << errors[k] << endl;
+        failed++;
+    }
+    cerr << files.size() - failed << "/" << files.size() << " circuits solved" << endl;
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && string(argv[1]) == "--batch") {
+        // DCCalculator --batch [-j threads] [-o outDir] [--cache] [--format f] netlists/dirs...
+        vector<string> paths;
+        string outDir;
+        int noOfThreads = 0;
+        bool useCache = false;
+        string format = "text";
+        for (int k(2); k < argc; k++) {
+            string arg = argv[k];
+            if ((arg == "-j" || arg == "-o" || arg == "--format") && k + 1 == argc) {
+                cerr << "Missing value after " << arg << endl;
+                return 2;
+            }
+            if (arg == "-j") noOfThreads = atoi(argv[++k]);
+            else if (arg == "-o") outDir = argv[++k];
+            else if (arg == "--cache") useCache = true;
+            else if (arg == "--format") format = argv[++k];
+            else paths.push_back(arg);
+        }
+        try {
+            return batch(paths, outDir, noOfThreads, useCache, resultFormat(format));
+        } catch (exception &e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+    if (argc > 1 && string(argv[1]) == "--serve") { // DCCalculator --serve [-j threads] [socket], stdin without socket
+        string socketPath;
+        int noOfThreads = 0;
+        for (int k(2); k < argc; k++) {
+            string arg = argv[k];
+            if (arg == "-j" && k + 1 < argc) noOfThreads = atoi(argv[++k]);
+            else socketPath = arg;
+        }
+        signal(SIGPIPE, SIG_IGN); // a client that goes away only ends its own session
+        SolverServer server;
+        try {
+            if (socketPath.empty()) server.serve(STDIN_FILENO, STDOUT_FILENO);
+            else server.listen(socketPath, noOfThreads);
+        } catch (exception &e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (argc > 1 && (string(argv[1]) == "--monte-carlo" || string(argv[1]) == "--sweep")) {
+        // DCCalculator --monte-carlo <samples> <tolerance %> [-j threads] [--seed s] <netlist>
+        // DCCalculator --sweep <component> <from> <to> <steps> [-j threads] <netlist>
+        string mode = argv[1];
+        int noOfParams = mode == "--sweep" ? 4 : 2, noOfThreads = 0;
+        unsigned long long seed = 1;
+        vector<string> args;
+        for (int k(2); k < argc; k++) {
+            string arg = argv[k];
+            if ((arg == "-j" || arg == "--seed") && k + 1 < argc) {
+                if (arg == "-j") noOfThreads = atoi(argv[++k]);
+                else seed = stoull(argv[++k]);
+            } else args.push_back(arg);
+        }
+        if (args.size() != noOfParams + 1) {
+            cerr << "Usage: DCCalculator " << (mode == "--sweep" ? "--sweep <component> <from> <to> <steps>"
+                                                                 : "--monte-carlo <samples> <tolerance %>")
+                 << " [-j threads] <netlist>" << endl;
+            return 2;
+        }
+        try {
+            Circuit cir(args.back());
+            cir.setRefNode(1);
+            vector<Variation> variations;
+            long samples;
+            if (mode == "--sweep") {
+                variations.push_back({stoi(args[0]) - 1, Variation::Sweep, stod(args[1]), stod(args[2])});
+                samples = stol(args[3]);
+            } else { // every resistor uniformly within its tolerance
+                samples = stol(args[0]);
+                double tolerance = stod(args[1]) / 100;
+                for (int c(0); c < cir.noOfComponents(); c++) {
+                    if (cir.getComponentType(c) != 1) continue;
+                    double r = cir.getComponentValue(c);
+                    variations.push_back({c, Variation::Uniform, r * (1 - tolerance), r * (1 + tolerance)});
+                }
+            }
+            printAnalysis(analyse(cir, variations, samples, noOfThreads, seed));
+        } catch (exception &e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--watch") { // DCCalculator --watch [--format f] [netlist], falstad.txt without
+        string fileName = "falstad.txt", format = "text";
+        for (int k(2); k < argc; k++) {
+            string arg = argv[k];
+            if (arg == "--format" && k + 1 < argc) format = argv[++k];
+            else fileName = arg;
+        }
+        try {
+            Watcher(fileName, cout, resultFormat(format)).run();
+        } catch (exception &e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--thevenin") {
+        // DCCalculator --thevenin <node> [node] [--load R]... <netlist>
+        vector<int> ports;
+        vector<double> loads;
+        int k = 2;
+        for (; k < argc - 1; k++) {
+            string arg = argv[k];
+            if (arg == "--load" && k + 2 < argc) loads.push_back(atof(argv[++k]));
+            else if (ports.size() < 2) ports.push_back(atoi(argv[k]));
+            else break;
+        }
+        if (ports.empty() || k != argc - 1) {
+            cerr << "Usage: DCCalculator --thevenin <node> [node] [--load R]... <netlist>" << endl;
+            return 2;
+        }
+        try {
+            Circuit cir(argv[k]);
+            cir.setRefNode(1);
+            const PortModel &model = cir.portModel(ports);
+            int b = ports.size() > 1 ? 1 : -1;
+            cout << "Theveninov ekvivalent između čvora " << ports[0]
+                 << (b < 0 ? string(" i referentnog čvora") : " i čvora " + to_string(ports[1])) << ":\n";
+            cout << "E_th = " << fixed3(model.theveninVoltage(0, b)) << "V\n";
+            cout << "R_th = " << fixed3(model.theveninResistance(0, b)) << "Ω\n";
+            for (double r: loads) { // each load is solved in the model, not in the whole circuit
+                Eigen::VectorXd v = model.loaded(0, b, r);
+                double u = v(0) - (b < 0 ? 0 : v(1));
+                cout << "R = " << fixed3(r) << "Ω: U = " << fixed3(u) << "V, I = " << fixed3(u / r * 1000) << "mA\n";
+            }
+        } catch (exception &e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (argc > 1) { // non-interactive: DCCalculator [--reduce-sources] [--mixed-precision] [--sensitivities] [--stats] [--cache] [--format f] [--chunks c] <netlist>
+        bool reduce = false, stats = false, useCache = false, mixed = false, sensitivities = false;
+        string format = "text";
+        int iterativeLimit = 10000;
+        double tolerance = 1e-10;
+        int k = 1;
+        for (; k < argc - 1; k++) {
+            string arg = argv[k];
+            if (arg == "--reduce-sources") reduce = true;
+            else if (arg == "--mixed-precision") mixed = true; // float factors refined in double
+            else if (arg == "--sensitivities") sensitivities = true; // d(reading)/d(value) with every reading
+            else if (arg == "--format" && k + 2 < argc) format = argv[++k]; // text, csv, jsonl or binary
+            else if (arg == "--iterative-limit" && k + 2 < argc) iterativeLimit = atoi(argv[++k]);
+            else if (arg == "--tolerance" && k + 2 < argc) tolerance = atof(argv[++k]);
+            else if (arg == "--stats") stats = true; // JSON report of phase timings and counters on stderr
+            else if (arg == "--cache") useCache = true; // compiled netlist in "<netlist>.dcc"
+            else if (arg == "--chunks" && k + 2 < argc) setNoOfChunks(atoi(argv[++k])); // parse and assemble in c chunks
+            else break;
+        }
+        string arg = argv[k];
+        if (arg.rfind("--", 0) == 0) {
+            cerr << "Missing netlist" << endl;
+            return 2;
+        }
+        try {
+            Circuit cir(arg, useCache, stats);
+            cir.setRefNode(1);
+            cir.setReducedSources(reduce);
+            cir.setMixedPrecision(mixed);
+            cir.setSensitivities(sensitivities);
+            cir.setIterative(iterativeLimit, tolerance);
+            cir.solve();
+            cir.writeSolution(cout, resultFormat(format));
+            if (stats) cir.statistics().printJson(cerr);
+        } catch (exception &e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
     try {
         program();
 //  For faster testing comment line above and uncomment lines below
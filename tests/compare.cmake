@@ -0,0 +1,28 @@
+# Runs PROGRAM with ARGS (a ;-list) on a copy of NETLIST in WORK_DIR and compares its output with EXPECTED.
+# RUNS runs it that many times on the same copy, e.g. to load the cache the first run wrote, and EDIT replaces
+# the copy with another netlist before the last run, e.g. to check that the cache is invalidated. CACHE is copied
+# next to the netlist as its compiled cache before the first run.
+if(NOT RUNS)
+    set(RUNS 1)
+endif()
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+configure_file(${NETLIST} ${WORK_DIR}/netlist.txt COPYONLY)
+if(CACHE)
+    configure_file(${CACHE} ${WORK_DIR}/netlist.txt.dcc COPYONLY)
+endif()
+foreach(run RANGE 1 ${RUNS})
+    if(EDIT AND run EQUAL RUNS)
+        configure_file(${EDIT} ${WORK_DIR}/netlist.txt COPYONLY)
+    endif()
+    execute_process(COMMAND ${PROGRAM} ${ARGS} netlist.txt WORKING_DIRECTORY ${WORK_DIR}
+                    OUTPUT_FILE ${WORK_DIR}/run${run}.out RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "Run ${run} of ${PROGRAM} ${ARGS} failed: ${status}")
+    endif()
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/run${run}.out ${EXPECTED}
+                    RESULT_VARIABLE different)
+    if(different AND (run EQUAL RUNS OR NOT EDIT))
+        message(FATAL_ERROR "Run ${run}: ${WORK_DIR}/run${run}.out differs from ${EXPECTED}")
+    endif()
+endforeach()